@@ -0,0 +1,114 @@
+// Per-CPU scheduling counters and process migrations.
+//
+//   cpustat            totals since boot
+//   cpustat cmd args   only what one run of cmd added, followed
+//                      by the migrations of each process it ran
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "cpustat.h"
+#include "procstat.h"
+
+#define MAXCPU  8    // NCPU
+
+static struct cpustat before[MAXCPU], after[MAXCPU];
+static struct procstat *stats;
+static int nstats;
+
+static int
+snapshot(struct cpustat *cs)
+{
+  int n;
+
+  if((n = cpustat(cs, MAXCPU)) < 0){
+    printf(2, "cpustat: cpustat failed\n");
+    exit();
+  }
+  return n;
+}
+
+// Read every process and completion record into stats,
+// growing it until getprocstats() leaves room to spare.
+// Returns the number of entries.
+static int
+procsnapshot(void)
+{
+  int n;
+
+  for(;;){
+    if(nstats > 0 && (n = getprocstats(stats, nstats)) < nstats)
+      return n;
+    if(stats)
+      free(stats);
+    nstats = nstats ? 2*nstats : 128;
+    if((stats = malloc(nstats * sizeof(*stats))) == 0){
+      printf(2, "cpustat: out of memory\n");
+      exit();
+    }
+  }
+}
+
+static void
+report(struct cpustat *cs, int n)
+{
+  int i;
+
+  printf(1, "cpu\tqueued\tswitch\tmigrate\tsteal\tpull\n");
+  for(i = 0; i < n; i++)
+    printf(1, "%d\t%d\t%d\t%d\t%d\t%d\n", cs[i].cpu, cs[i].queued,
+           cs[i].nswtch, cs[i].nmigrate, cs[i].nsteal, cs[i].npull);
+}
+
+// Migrations of the processes from pid on, which pids only
+// growing makes those started since pid was forked.
+static void
+migrations(int pid)
+{
+  int i, n;
+
+  n = procsnapshot();
+  printf(1, "\npid\truns\tmigrate\tname\n");
+  for(i = 0; i < n; i++){
+    if(stats[i].pid < pid)
+      continue;
+    printf(1, "%d\t%d\t%d\t%s\n", stats[i].pid, stats[i].num_run,
+           stats[i].nmigrate, stats[i].state ? stats[i].name : "-");
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int pid, i, n;
+
+  if(argc < 2){
+    n = snapshot(after);
+    report(after, n);
+    exit();
+  }
+
+  snapshot(before);
+  pid = fork();
+  if(pid < 0){
+    printf(2, "cpustat: fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    exec(argv[1], argv + 1);
+    printf(2, "cpustat: exec %s failed\n", argv[1]);
+    exit();
+  }
+  while(wait() != pid)
+    ;
+  n = snapshot(after);
+  for(i = 0; i < n; i++){
+    after[i].nswtch -= before[i].nswtch;
+    after[i].nmigrate -= before[i].nmigrate;
+    after[i].nsteal -= before[i].nsteal;
+    after[i].npull -= before[i].npull;
+  }
+  report(after, n);
+  migrations(pid);
+  exit();
+}
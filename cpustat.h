@@ -0,0 +1,9 @@
+// Per-CPU scheduling counters, as returned by cpustat().
+struct cpustat {
+  int cpu;
+  int queued;        // RUNNABLE processes on its queue now
+  uint nswtch;       // Context switches
+  uint nmigrate;     // Runs of a process that last ran on another CPU
+  uint nsteal;       // Processes taken from other queues when idle
+  uint npull;        // Processes moved here by the balancer
+};
@@ -1,14 +1,18 @@
 struct buf;
 struct context;
+struct cpu;
 struct file;
 struct inode;
+struct perfrec;
 struct pipe;
 struct proc;
+struct schedev;
 struct rtcdate;
 struct spinlock;
 struct sleeplock;
 struct stat;
 struct superblock;
+struct trapframe;
 
 // bio.c
 void            binit(void);
@@ -65,6 +69,10 @@ void            ioapicinit(void);
 
 // kalloc.c
 char*           kalloc(void);
+void*           bootalloc(uint);
+void            kref(char*);
+int             krefs(char*);
+uint            kfreepages(void);
 void            kfree(char*);
 void            kinit1(void*, void*);
 void            kinit2(void*, void*);
@@ -78,7 +86,11 @@ int             lapicid(void);
 extern volatile uint*    lapic;
 void            lapiceoi(void);
 void            lapicinit(void);
+void            lapicipi(int, int);
 void            lapicstartap(uchar, uint);
+void            lapictimer(int);
+uint64          tsc2ns(uint64);
+uint64          tscsince(uint64);
 void            microdelay(int);
 
 // log.c
@@ -95,6 +107,14 @@ void            mpinit(void);
 void            picenable(int);
 void            picinit(void);
 
+// perf.c
+void            perfinit(void);
+void            perffill(struct proc*, struct perfrec*);
+void            perfrecord(struct proc*);
+int             perfget(int, int, struct perfrec*);
+int             perflookup(int, struct perfrec*);
+int             perfdrain(struct perfrec*, int);
+
 // pipe.c
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
@@ -102,6 +122,10 @@ int             piperead(struct pipe*, char*, int);
 int             pipewrite(struct pipe*, char*, int);
 
 //PAGEBREAK: 16
+// prof.c
+extern int      profiling;
+void            profsample(struct trapframe*);
+
 // proc.c
 int             cpuid(void);
 void            exit(void);
@@ -113,10 +137,13 @@ struct cpu*     mycpu(void);
 struct proc*    myproc();
 void            pinit(void);
 void            procdump(void);
+int             proclocks(struct spinlock*);
 void            scheduler(void) __attribute__((noreturn));
 void            sched(void);
 void            setproc(struct proc*);
 void            sleep(void*, struct spinlock*);
+int             sleepuntil(uint);
+void            timerwake(uint);
 void            userinit(void);
 int             wait(void);
 void            wakeup(void*);
@@ -126,6 +153,22 @@ int             get_start_time(int pid);
 int             get_completion_time(int pid);
 int             get_total_run_time(int pid);
 int             get_total_ready_time(int pid);
+int             getprocns(int pid, struct perfrec*);
+
+// runq.c
+void            rqinit(void);
+void            rqadd(struct proc*);
+struct proc*    rqpick(struct cpu*);
+int             rqready(struct cpu*);
+int             rqtick(struct proc*);
+void            rqclock(void);
+void            rqbalance(void);
+extern int      defquantum;
+
+// trace.c
+void            traceinit(void);
+void            trace(int, int, int);
+int             tracedrain(struct schedev*, int);
 
 // swtch.S
 void            swtch(struct context**, struct context*);
@@ -135,6 +178,8 @@ void            acquire(struct spinlock*);
 void            getcallerpcs(void*, uint*);
 int             holding(struct spinlock*);
 void            initlock(struct spinlock*, char*);
+void            initlockunlisted(struct spinlock*, char*);
+void            freelock(struct spinlock*);
 void            release(struct spinlock*);
 void            pushcli(void);
 void            popcli(void);
@@ -187,9 +232,11 @@ void            freevm(pde_t*);
 void            inituvm(pde_t*, char*, uint);
 int             loaduvm(pde_t*, char*, struct inode*, uint, uint);
 pde_t*          copyuvm(pde_t*, uint);
+int             uvmfault(pde_t*, uint, uint, int);
+int             uvmtouch(pde_t*, uint, uint, uint, int);
 void            switchuvm(struct proc*);
 void            switchkvm(void);
-int             copyout(pde_t*, uint, void*, uint);
+int             copyout(pde_t*, uint, uint, void*, uint);
 void            clearpteu(pde_t *pgdir, char *uva);
 
 // number of elements in fixed-size array
@@ -1,6 +1,10 @@
 // Physical memory allocator, intended to allocate
 // memory for user processes, kernel stacks, page table pages,
 // and pipe buffers. Allocates 4096-byte pages.
+//
+// Each page has a reference count so that copy-on-write
+// fork() can map one page into several address spaces;
+// kfree() only frees a page when its last reference goes.
 
 #include "types.h"
 #include "defs.h"
@@ -21,8 +25,14 @@ struct {
   struct spinlock lock;
   int use_lock;
   struct run *freelist;
+  uint nfree;                  // Pages on freelist
+  ushort ref[PHYSTOP/PGSIZE];  // References to each page; 0 if free
 } kmem;
 
+// Tables sized at boot come from the bottom of the memory
+// kinit2() will free; kinit2() starts above them.
+static char *bootnext = P2V(4*1024*1024);
+
 // Initialization happens in two phases.
 // 1. main() calls kinit1() while still using entrypgdir to place just
 // the pages mapped by entrypgdir on free list.
@@ -39,6 +49,8 @@ kinit1(void *vstart, void *vend)
 void
 kinit2(void *vstart, void *vend)
 {
+  if((char*)vstart < bootnext)
+    vstart = bootnext;
   freerange(vstart, vend);
   kmem.use_lock = 1;
 }
@@ -64,6 +76,19 @@ kfree(char *v)
   if((uint)v % PGSIZE || v < end || V2P(v) >= PHYSTOP)
     panic("kfree");
 
+  if(kmem.use_lock)
+    acquire(&kmem.lock);
+  if(kmem.ref[V2P(v)/PGSIZE] > 1){
+    // Still mapped by another process.
+    kmem.ref[V2P(v)/PGSIZE]--;
+    if(kmem.use_lock)
+      release(&kmem.lock);
+    return;
+  }
+  kmem.ref[V2P(v)/PGSIZE] = 0;
+  if(kmem.use_lock)
+    release(&kmem.lock);
+
   // Fill with junk to catch dangling refs.
   memset(v, 1, PGSIZE);
 
@@ -72,10 +97,28 @@ kfree(char *v)
   r = (struct run*)v;
   r->next = kmem.freelist;
   kmem.freelist = r;
+  kmem.nfree++;
   if(kmem.use_lock)
     release(&kmem.lock);
 }
 
+// Allocate n zeroed bytes, page aligned, that are never freed.
+// Only for use before kinit2(), once kvmalloc() has mapped
+// all of physical memory.
+void*
+bootalloc(uint n)
+{
+  char *p;
+
+  n = PGROUNDUP(n);
+  if(kmem.use_lock || n > PHYSTOP - V2P(bootnext))
+    panic("bootalloc");
+  p = bootnext;
+  bootnext += n;
+  memset(p, 0, n);
+  return p;
+}
+
 // Allocate one 4096-byte page of physical memory.
 // Returns a pointer that the kernel can use.
 // Returns 0 if the memory cannot be allocated.
@@ -87,10 +130,39 @@ kalloc(void)
   if(kmem.use_lock)
     acquire(&kmem.lock);
   r = kmem.freelist;
-  if(r)
+  if(r){
     kmem.freelist = r->next;
+    kmem.nfree--;
+    kmem.ref[V2P(r)/PGSIZE] = 1;
+  }
   if(kmem.use_lock)
     release(&kmem.lock);
   return (char*)r;
 }
 
+// Add a reference to the allocated page v.
+void
+kref(char *v)
+{
+  acquire(&kmem.lock);
+  if(kmem.ref[V2P(v)/PGSIZE] == 0)
+    panic("kref");
+  kmem.ref[V2P(v)/PGSIZE]++;
+  release(&kmem.lock);
+}
+
+// Number of free pages, a hint for sizing requests.
+uint
+kfreepages(void)
+{
+  return kmem.nfree;
+}
+
+// Number of references to page v.  Only a hint, unless the
+// caller holds the only one, which nobody else can copy.
+int
+krefs(char *v)
+{
+  return kmem.ref[V2P(v)/PGSIZE];
+}
+
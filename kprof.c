@@ -0,0 +1,268 @@
+// Flat profile from the kernel's timer-interrupt sampler.
+//
+//   kprof            print the samples collected so far
+//   kprof cmd args   profile one run of cmd
+//
+// Kernel PCs are resolved against /kernel.sym; user samples
+// are totalled per process.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+#include "prof.h"
+
+#define MAXROW  512
+#define KERNBASE 0x80000000
+
+struct row {
+  int sym;        // index in syms, or -1
+  int caller;     // index in syms, -1 if none, -2 if not split
+  int pid;        // user rows
+  uint count;
+};
+
+static struct profent *ent;
+static int nent;
+static struct row rows[MAXROW];
+static int nrow;
+
+static uint *symaddr;
+static char **symname;
+static int nsym;
+
+static int
+hexval(char c)
+{
+  if(c >= '0' && c <= '9')
+    return c - '0';
+  if(c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  return -1;
+}
+
+// Read "address name" lines from kernel.sym, sorted by address.
+static void
+loadsyms(char *path)
+{
+  struct stat st;
+  char *buf, *p, *name;
+  uint a;
+  int fd, n, i, j, v, tot;
+
+  if((fd = open(path, O_RDONLY)) < 0 || fstat(fd, &st) < 0){
+    printf(2, "kprof: cannot read %s\n", path);
+    return;
+  }
+  buf = malloc(st.size + 1);
+  for(tot = 0; tot < st.size; tot += n)
+    if((n = read(fd, buf + tot, st.size - tot)) <= 0)
+      break;
+  buf[tot] = 0;
+  close(fd);
+
+  n = 0;
+  for(p = buf; *p; p++)
+    if(*p == '\n')
+      n++;
+  symaddr = malloc((n+1) * sizeof(uint));
+  symname = malloc((n+1) * sizeof(char*));
+
+  for(p = buf; *p; ){
+    a = 0;
+    while((v = hexval(*p)) >= 0){
+      a = a*16 + v;
+      p++;
+    }
+    if(*p == ' ')
+      p++;
+    name = p;
+    while(*p && *p != '\n')
+      p++;
+    if(*p)
+      *p++ = 0;
+    if(name[0] && name[0] != '.'){
+      symaddr[nsym] = a;
+      symname[nsym] = name;
+      nsym++;
+    }
+  }
+
+  // Insertion sort; the table is a few hundred entries.
+  for(i = 1; i < nsym; i++){
+    a = symaddr[i];
+    name = symname[i];
+    for(j = i; j > 0 && symaddr[j-1] > a; j--){
+      symaddr[j] = symaddr[j-1];
+      symname[j] = symname[j-1];
+    }
+    symaddr[j] = a;
+    symname[j] = name;
+  }
+}
+
+// Index of the symbol containing kernel address pc, or -1.
+static int
+lookup(uint pc)
+{
+  int lo, hi, mid;
+
+  if(pc < KERNBASE || nsym == 0 || pc < symaddr[0])
+    return -1;
+  lo = 0;
+  hi = nsym - 1;
+  while(lo < hi){
+    mid = (lo + hi + 1) / 2;
+    if(symaddr[mid] <= pc)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  return lo;
+}
+
+static void
+add(int sym, int caller, int pid, uint count)
+{
+  struct row *r;
+
+  for(r = rows; r < &rows[nrow]; r++)
+    if(r->sym == sym && r->caller == caller && r->pid == pid){
+      r->count += count;
+      return;
+    }
+  if(nrow == MAXROW)
+    return;
+  r->sym = sym;
+  r->caller = caller;
+  r->pid = pid;
+  r->count = count;
+  nrow++;
+}
+
+static void
+sortrows(void)
+{
+  struct row t;
+  int i, j;
+
+  for(i = 1; i < nrow; i++){
+    t = rows[i];
+    for(j = i; j > 0 && rows[j-1].count < t.count; j--)
+      rows[j] = rows[j-1];
+    rows[j] = t;
+  }
+}
+
+static char*
+symstr(int sym)
+{
+  return sym >= 0 ? symname[sym] : "?";
+}
+
+// Read every histogram entry into ent, growing it until
+// getprof() leaves room to spare.  Returns the number of
+// entries, or -1.
+static int
+readprof(void)
+{
+  int n;
+
+  for(;;){
+    if(nent > 0 && (n = getprof(ent, nent)) < nent)
+      return n;
+    if(ent)
+      free(ent);
+    nent = nent ? 2*nent : 1024;
+    if((ent = malloc(nent * sizeof(*ent))) == 0){
+      printf(2, "kprof: out of memory\n");
+      exit();
+    }
+  }
+}
+
+static void
+report(void)
+{
+  struct profent *e;
+  struct row *r;
+  uint total;
+  int n;
+
+  n = readprof();
+  if(n < 0){
+    printf(2, "kprof: getprof failed\n");
+    return;
+  }
+  total = 0;
+  for(e = ent; e < &ent[n]; e++)
+    total += e->count;
+  if(total == 0){
+    printf(1, "no samples\n");
+    return;
+  }
+
+  // Flat profile: samples per kernel function or user process.
+  nrow = 0;
+  for(e = ent; e < &ent[n]; e++){
+    if(e->pc == 0)
+      add(-1, -2, -1, e->count);
+    else if(e->user)
+      add(-1, -2, e->pid, e->count);
+    else
+      add(lookup(e->pc), -2, 0, e->count);
+  }
+  sortrows();
+  printf(1, "%d samples\n  count    %%  function\n", total);
+  for(r = rows; r < &rows[nrow]; r++){
+    printf(1, "%d\t%d\t", r->count, r->count * 100 / total);
+    if(r->pid > 0)
+      printf(1, "(user, pid %d)\n", r->pid);
+    else if(r->pid < 0)
+      printf(1, "(dropped)\n");
+    else
+      printf(1, "%s\n", symstr(r->sym));
+  }
+
+  // Kernel samples split by caller.
+  nrow = 0;
+  for(e = ent; e < &ent[n]; e++)
+    if(e->pc != 0 && !e->user)
+      add(lookup(e->pc), lookup(e->caller), 0, e->count);
+  sortrows();
+  printf(1, "\n  count  function <- caller\n");
+  for(r = rows; r < &rows[nrow]; r++)
+    printf(1, "%d\t%s <- %s\n", r->count, symstr(r->sym), symstr(r->caller));
+}
+
+int
+main(int argc, char *argv[])
+{
+  int pid;
+
+  loadsyms("/kernel.sym");
+  if(argc < 2){
+    report();
+    exit();
+  }
+
+  if(profctl(1) < 0){
+    printf(2, "kprof: profctl failed\n");
+    exit();
+  }
+  pid = fork();
+  if(pid < 0){
+    printf(2, "kprof: fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    exec(argv[1], argv + 1);
+    printf(2, "kprof: exec %s failed\n", argv[1]);
+    exit();
+  }
+  while(wait() != pid)
+    ;
+  profctl(0);
+  report();
+  exit();
+}
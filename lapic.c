@@ -43,6 +43,14 @@
 
 volatile uint *lapic;  // Initialized in mp.c
 
+#define TICKCOUNT 10000000   // lapic[TICR] for one tick
+#define TICKNS    10000000   // nanoseconds in one tick
+
+static uint64 tscboot;       // TSC at calibration
+static uint tscmult;         // ns per TSC cycle, fixed point << 24
+
+static void tsccalibrate(void);
+
 //PAGEBREAK!
 static void
 lapicw(int index, int value)
@@ -65,8 +73,9 @@ lapicinit(void)
   // If xv6 cared more about precise timekeeping,
   // TICR would be calibrated using an external time source.
   lapicw(TDCR, X1);
-  lapicw(TIMER, PERIODIC | (T_IRQ0 + IRQ_TIMER));
-  lapicw(TICR, 10000000);
+  lapictimer(1);
+  if(tscmult == 0)
+    tsccalibrate();
 
   // Disable logical interrupt lines.
   lapicw(LINT0, MASKED);
@@ -105,6 +114,83 @@ lapicid(void)
   return lapic[ID] >> 24;
 }
 
+// Start (on != 0) or stop this CPU's periodic timer.
+void
+lapictimer(int on)
+{
+  if(!lapic)
+    return;
+  if(on){
+    lapicw(TIMER, PERIODIC | (T_IRQ0 + IRQ_TIMER));
+    lapicw(TICR, TICKCOUNT);
+  } else
+    lapicw(TIMER, MASKED);
+}
+
+// 64-by-32 bit division; the kernel has no libgcc for __udivdi3.
+static uint64
+div64(uint64 n, uint d)
+{
+  uint hi, lo, r;
+
+  hi = (uint)(n >> 32) / d;
+  r = (uint)(n >> 32) % d;
+  asm("divl %2" : "=a" (lo), "+d" (r) : "rm" (d), "a" ((uint)n));
+  return ((uint64)hi << 32) | lo;
+}
+
+// Count TSC cycles while the timer that was just started counts
+// down a tenth of a tick.  Like the rest of xv6 this takes a tick
+// to be TICKNS; ns values are only as accurate as that.
+static void
+tsccalibrate(void)
+{
+  uint t0, t1;
+  uint64 s0, s1, pertick;
+
+  t0 = lapic[TCCR];
+  s0 = rdtsc();
+  do {
+    t1 = lapic[TCCR];
+  } while(t0 - t1 < TICKCOUNT/10);
+  s1 = rdtsc();
+
+  pertick = div64((s1 - s0) * TICKCOUNT, t0 - t1);
+  if(pertick == 0 || pertick >> 32)
+    return;
+  tscmult = div64((uint64)TICKNS << 24, pertick);
+  tscboot = s1;
+}
+
+// Convert a count of TSC cycles to nanoseconds.
+uint64
+tsc2ns(uint64 cycles)
+{
+  return (((cycles >> 32) * tscmult) << 8) +
+    (((uint64)(uint)cycles * tscmult) >> 24);
+}
+
+// Nanoseconds since boot at TSC value tsc; 0 if tsc is 0.
+uint64
+tscsince(uint64 tsc)
+{
+  if(tsc == 0 || tsc < tscboot)
+    return 0;
+  return tsc2ns(tsc - tscboot);
+}
+
+// Send interrupt vector to the CPU with the given APIC ID.
+void
+lapicipi(int apicid, int vector)
+{
+  if(!lapic)
+    return;
+  lapicw(ICRHI, apicid<<24);
+  lapicw(ICRLO, FIXED | ASSERT | vector);
+  while(lapic[ICRLO] & DELIVS)
+    ;
+}
+
 // Acknowledge interrupt.
 void
 lapiceoi(void)
@@ -0,0 +1,83 @@
+// Compare the kernel's ticket spinlock with the xchg
+// test-and-set loop it replaced.  nproc processes hammer
+// one kernel lock at the same time; a fair lock lets them
+// all finish at about the same time.
+//
+//   lockbench [nproc [iters]]
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+static char *kinds[] = { "ticket", "xchg" };
+
+static void
+run(int kind, int nproc, int iters)
+{
+  int start[2], done[2];
+  int i, pid;
+  uint64 ns;
+  uint us, min, max, sum;
+  char c;
+
+  if(pipe(start) < 0 || pipe(done) < 0){
+    printf(2, "lockbench: pipe failed\n");
+    exit();
+  }
+  for(i = 0; i < nproc; i++){
+    pid = fork();
+    if(pid < 0){
+      printf(2, "lockbench: fork failed\n");
+      exit();
+    }
+    if(pid == 0){
+      close(start[1]);
+      read(start[0], &c, 1);  // start together
+      if(lockbench(kind, iters, &ns) < 0)
+        ns = 0;
+      write(done[1], &ns, sizeof(ns));
+      exit();
+    }
+  }
+  close(start[0]);
+  for(i = 0; i < nproc; i++)
+    write(start[1], "x", 1);
+  close(start[1]);
+
+  min = ~0;
+  max = sum = 0;
+  for(i = 0; i < nproc; i++){
+    read(done[0], &ns, sizeof(ns));
+    us = ns >> 10;  // ~us; the user library has no 64-bit divide
+    if(us < min)
+      min = us;
+    if(us > max)
+      max = us;
+    sum += us;
+  }
+  for(i = 0; i < nproc; i++)
+    wait();
+  close(done[0]);
+  close(done[1]);
+
+  printf(1, "%s:\tfastest %d us, slowest %d us, mean %d us, "
+         "slowest/fastest %d%%\n", kinds[kind], min, max, sum / nproc,
+         min ? max * 100 / min : 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nproc, iters;
+
+  nproc = argc > 1 ? atoi(argv[1]) : 4;
+  iters = argc > 2 ? atoi(argv[2]) : 100000;
+  if(nproc < 1 || iters < 1){
+    printf(2, "usage: lockbench [nproc [iters]]\n");
+    exit();
+  }
+  printf(1, "%d processes, %d acquisitions each\n", nproc, iters);
+  run(0, nproc, iters);
+  run(1, nproc, iters);
+  exit();
+}
@@ -0,0 +1,132 @@
+// Spinlock contention report, hottest locks first.
+// Locks with the same name, such as the per-buffer
+// sleep locks, are added together.
+//
+//   lockstat            totals since boot
+//   lockstat cmd args   only what one run of cmd added
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "lockstat.h"
+
+// Read all locks into a new array, one entry per name,
+// and its length into *np.
+static struct lockstat*
+snapshot(int *np)
+{
+  struct lockstat *raw, *ls;
+  int i, j, n, m, max;
+
+  // Locks can be made between the two calls; if the
+  // buffer filled, ask again.
+  raw = 0;
+  do {
+    if(raw)
+      free(raw);
+    if((max = lockstat(0, 0)) < 0)
+      goto bad;
+    max += 16;
+    raw = malloc(max * sizeof(*raw));
+    if((n = lockstat(raw, max)) < 0)
+      goto bad;
+  } while(n == max);
+
+  ls = malloc((n+1) * sizeof(*ls));
+  m = 0;
+  for(i = 0; i < n; i++){
+    for(j = 0; j < m; j++)
+      if(strcmp(ls[j].name, raw[i].name) == 0)
+        break;
+    if(j == m)
+      ls[m++] = raw[i];
+    else {
+      ls[j].nacquire += raw[i].nacquire;
+      ls[j].ncontend += raw[i].ncontend;
+      ls[j].spinns += raw[i].spinns;
+    }
+  }
+  free(raw);
+  *np = m;
+  return ls;
+
+bad:
+  printf(2, "lockstat: lockstat failed\n");
+  exit();
+}
+
+// Subtract the matching entries of old from ls.
+static void
+subtract(struct lockstat *ls, int n, struct lockstat *old, int nold)
+{
+  int i, j;
+
+  for(i = 0; i < n; i++)
+    for(j = 0; j < nold; j++)
+      if(strcmp(ls[i].name, old[j].name) == 0){
+        ls[i].nacquire -= old[j].nacquire;
+        ls[i].ncontend -= old[j].ncontend;
+        ls[i].spinns = ls[i].spinns > old[j].spinns ?
+          ls[i].spinns - old[j].spinns : 0;
+        break;
+      }
+}
+
+static void
+report(struct lockstat *ls, int n)
+{
+  struct lockstat t;
+  int i, j;
+
+  // Most spin time first, then most contention.
+  for(i = 1; i < n; i++){
+    t = ls[i];
+    for(j = i; j > 0 && (ls[j-1].spinns < t.spinns ||
+        (ls[j-1].spinns == t.spinns && ls[j-1].ncontend < t.ncontend)); j--)
+      ls[j] = ls[j-1];
+    ls[j] = t;
+  }
+  printf(1, "name\t\tacquire\tcontend\tspin us\n");
+  for(i = 0; i < n; i++){
+    if(ls[i].nacquire == 0)
+      continue;
+    printf(1, "%s\t", ls[i].name);
+    if(strlen(ls[i].name) < 8)
+      printf(1, "\t");
+    // Microseconds, without 64-bit division: spinns >> 10 is
+    // within 3% and fits in an int for ~70 minutes of spinning.
+    printf(1, "%d\t%d\t%d\n", ls[i].nacquire, ls[i].ncontend,
+           (uint)(ls[i].spinns >> 10));
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct lockstat *before, *after;
+  int pid, n, nold;
+
+  if(argc < 2){
+    after = snapshot(&n);
+    report(after, n);
+    exit();
+  }
+
+  before = snapshot(&nold);
+  pid = fork();
+  if(pid < 0){
+    printf(2, "lockstat: fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    exec(argv[1], argv + 1);
+    printf(2, "lockstat: exec %s failed\n", argv[1]);
+    exit();
+  }
+  while(wait() != pid)
+    ;
+  after = snapshot(&n);
+  subtract(after, n, before, nold);
+  report(after, n);
+  exit();
+}
@@ -0,0 +1,7 @@
+// Spinlock contention statistics, as returned by lockstat().
+struct lockstat {
+  char name[16];
+  uint nacquire;     // Acquisitions
+  uint ncontend;     // Acquisitions that had to spin
+  uint64 spinns;     // Time spent spinning
+};
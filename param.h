@@ -1,4 +1,3 @@
-#define NPROC        64  // maximum number of processes
 #define KSTACKSIZE 4096  // size of per-process kernel stack
 #define NCPU          8  // maximum number of CPUs
 #define NOFILE       16  // open files per process
@@ -10,6 +9,22 @@
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
 #define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
 #define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
-#define FSSIZE       1000  // size of file system in blocks
+#define FSSIZE       2000  // size of file system in blocks
 #define DEFAULT_TICKETS 10
+#define MAXTICKETS 10000  // most tickets set_tickets() allows
+#define NMLFQ         4  // number of MLFQ priority levels
+#define MLFQBOOST   100  // ticks between MLFQ priority boosts
+#define BALANCETICKS 10  // ticks between run queue balancing passes
+#define MAXQUANTUM  100  // longest time slice setquantum() allows
+#define NPERFREC     64  // completion records kept per CPU
+#define NTRACE      256  // scheduler trace events kept per CPU
+#define NPROFHASH   512  // profiler histogram slots per CPU
+#define NLOCKSTAT   512  // spinlocks tracked for lockstat()
+#define NLOCKSUM      2  // groups of locks lockstat() reports summed
+#ifndef MAXPROC
+#define MAXPROC    4096  // cap on the process table sized at boot
+#endif
+#ifndef CFSMINSLICE
+#define CFSMINSLICE   2  // minimum CFS time slice in ticks
+#endif
 
@@ -0,0 +1,170 @@
+// Completion records for exited processes.
+//
+// Each CPU owns a ring of the last NPERFREC records.  The only
+// writer of a ring is the scheduler on that CPU, which logs a
+// process when it comes back from swtch() as a ZOMBIE, so adding
+// a record takes no lock.  Records carry a per-CPU sequence
+// number starting at 1; when a ring wraps, the oldest record is
+// overwritten and readers see a gap in the sequence.
+//
+// Readers never block the writer.  A record is valid only if
+// its seq is the one expected both before and after copying it
+// out, seqlock style.  drainperf() hands records to user space
+// and advances a per-ring consumer cursor; lookups by pid for
+// the get_*_time() calls read the rings without consuming.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "x86.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "procstat.h"
+
+struct perfring {
+  struct perfrec rec[NPERFREC];
+  volatile uint head;   // seq of the newest record; 0 if none
+  uint tail;            // seq of the last record drained
+};
+
+static struct perfring perfring[NCPU];
+static struct spinlock drainlock;  // serializes consumers only
+
+void
+perfinit(void)
+{
+  initlock(&drainlock, "perfdrain");
+}
+
+// Fill in everything but e->seq from p.
+void
+perffill(struct proc *p, struct perfrec *e)
+{
+  e->cpu = p->cpu;
+  e->pid = p->pid;
+  e->creation_time = p->creation_time;
+  e->start_time = p->start_time;
+  e->completion_time = p->completion_time;
+  e->total_run_time = p->total_run_time;
+  e->total_ready_time = p->total_ready_time;
+  e->total_sleep_time = p->total_sleep_time;
+  e->num_run = p->num_run;
+  e->nmigrate = p->nmigrate;
+  e->creation_ns = tscsince(p->tsc_create);
+  e->start_ns = tscsince(p->tsc_start);
+  e->completion_ns = tscsince(p->tsc_done);
+  e->run_ns = tsc2ns(p->tsc_run);
+  e->ready_ns = tsc2ns(p->tsc_ready);
+  e->sleep_ns = tsc2ns(p->tsc_sleep);
+}
+
+// Log p's metrics on this CPU's ring.
+// Called from scheduler() with interrupts disabled.
+void
+perfrecord(struct proc *p)
+{
+  struct perfring *r;
+  struct perfrec *e;
+  uint seq;
+
+  r = &perfring[cpuid()];
+  seq = r->head + 1;
+  e = &r->rec[(seq - 1) % NPERFREC];
+
+  e->seq = 0;  // readers now fail on this slot
+  __sync_synchronize();
+  perffill(p, e);
+  __sync_synchronize();
+  e->seq = seq;
+  r->head = seq;
+}
+
+// Copy record seq of ring r to *out.
+// Returns -1 if it has been overwritten or is being written.
+static int
+perfread(struct perfring *r, uint seq, struct perfrec *out)
+{
+  struct perfrec *e;
+
+  e = &r->rec[(seq - 1) % NPERFREC];
+  if(e->seq != seq)
+    return -1;
+  __sync_synchronize();
+  *out = *e;
+  __sync_synchronize();
+  if(e->seq != seq)
+    return -1;
+  return 0;
+}
+
+// Copy the i'th newest record of cpu's ring to *out.
+// Returns -1 if there is no such record.
+int
+perfget(int cpu, int i, struct perfrec *out)
+{
+  struct perfring *r;
+  uint h;
+
+  r = &perfring[cpu];
+  h = r->head;
+  if(i < 0 || i >= NPERFREC || i >= h)
+    return -1;
+  return perfread(r, h - i, out);
+}
+
+// Find the completion record of pid.  Returns 0 on success.
+int
+perflookup(int pid, struct perfrec *out)
+{
+  int c, i;
+
+  for(c = 0; c < ncpu; c++)
+    for(i = 0; i < NPERFREC; i++){
+      if(perfget(c, i, out) < 0)
+        continue;
+      if(out->pid == pid)
+        return 0;
+    }
+  return -1;
+}
+
+// Move up to max records not yet drained into buf.
+// Records overwritten before being drained are skipped;
+// the consumer sees them as gaps in each CPU's seq.
+int
+perfdrain(struct perfrec *buf, int max)
+{
+  struct perfring *r;
+  uint h;
+  int n;
+
+  n = 0;
+  acquire(&drainlock);
+  for(r = perfring; r < &perfring[ncpu] && n < max; r++){
+    h = r->head;
+    if(h - r->tail > NPERFREC)
+      r->tail = h - NPERFREC;
+    while(r->tail != h && n < max){
+      if(perfread(r, r->tail + 1, &buf[n]) == 0)
+        n++;
+      r->tail++;
+    }
+  }
+  release(&drainlock);
+  return n;
+}
+
+int
+sys_drainperf(void)
+{
+  struct perfrec *buf;
+  int max;
+
+  if(argint(1, &max) < 0 || max < 0)
+    return -1;
+  if(argptr(0, (char**)&buf, max*sizeof(*buf)) < 0)
+    return -1;
+  return perfdrain(buf, max);
+}
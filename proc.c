@@ -4,45 +4,107 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "x86.h"
-#include "proc.h"
 #include "spinlock.h"
+#include "proc.h"
 #include "random.h"
+#include "procstat.h"
+#include "trace.h"
 extern int uptime(void);
 
 
 
 
+// Locking.  Each process has its own lock, p->lock, which
+// guards its state and is held across the swtch() into and out
+// of it, as ptable.lock used to be.  The remaining locks are
+// only for the shared structures that link processes together:
+//
+//   ptable.lock     parent/child links, for wait() and exit()
+//   ptable.freelock the list of UNUSED slots
+//   sleepq[i].lock  one wait-channel bucket
+//   ptable.tqlock   the sleepuntil() timer wheel
+//   ptable.pidlock  the pid index
+//
+// Order: ptable.lock, then any condition lock passed to
+// sleep() or tqlock, then a sleepq lock, then p->lock, then a
+// run queue lock.  pidlock nests between ptable.lock and
+// p->lock: wait() drops a zombie from the pid index with
+// ptable.lock held, and findproc() locks the process it finds
+// with pidlock held.  freelock comes after p->lock.
+
+struct sleepq {
+  struct spinlock lock;
+  struct proc *head;   // SLEEPING processes hashed here by chan
+};
+
 struct {
   struct spinlock lock;
-  struct proc proc[NPROC];
+  struct proc *proc;             // NPROC entries, from bootalloc()
+  struct spinlock freelock;
+  struct proc *freelist;         // UNUSED slots, lowest first at boot
+  struct sleepq *sleepq;         // nhash wait-channel buckets
+  struct spinlock tqlock;
+  struct proc **timerq;          // nhash timer wheel slots, for sleepuntil()
+  struct spinlock pidlock;
+  struct proc **pidhash;         // nhash buckets of allocated processes by pid
 } ptable;
 
-// Performance metrics storage
-struct PerfData perf_data[NPROC];
-struct spinlock perf_lock;  // Lock for accessing perf_data
+// Size of each of the tables above, set by pinit(): the
+// power of two at or above nproc, so that chains stay short
+// however many processes the machine holds.
+static uint nhash;
+
 uint last_completion_time;  // Track the last completion time
 
 static struct proc *initproc;
 
 int nextpid = 1;
+int nproc;
+
+// The least memory a process can live in: its kernel stack, its
+// page directory, the page tables mapping the kernel into it,
+// and a few pages of user memory.
+#define PROCMEM (KSTACKSIZE + PGSIZE + PHYSTOP/NPTENTRIES + 4*PGSIZE)
 extern void forkret(void);
 extern void trapret(void);
 
 
 
-static void wakeup1(void *chan);
+static struct sleepq *sleepq(void *chan);
+static void sleepqadd(struct proc *p);
+static void setrunnable(struct proc *p);
+static void swtchdone(void);
 
 void
 pinit(void)
 {
   initlock(&ptable.lock, "ptable");
-  initlock(&perf_lock, "perfdata");
+  initlock(&ptable.tqlock, "timerq");
+  initlock(&ptable.pidlock, "pidhash");
+  initlock(&ptable.freelock, "procfree");
+
+  // One slot for each process the memory above the
+  // kernel could hold.
+  nproc = (PHYSTOP - 4*1024*1024) / PROCMEM;
+  if(nproc > MAXPROC)
+    nproc = MAXPROC;
+  ptable.proc = bootalloc(nproc * sizeof(struct proc));
+  for(nhash = 1; nhash < nproc; nhash *= 2)
+    ;
+  ptable.sleepq = bootalloc(nhash * sizeof(struct sleepq));
+  ptable.timerq = bootalloc(nhash * sizeof(struct proc*));
+  ptable.pidhash = bootalloc(nhash * sizeof(struct proc*));
+  rqinit();
   last_completion_time = 0;  // Initialize last completion time
-  
-  // Initialize performance data
-  for(int i = 0; i < NPROC; i++) {
-    perf_data[i].valid = 0;
+
+  for(int i = NPROC-1; i >= 0; i--){
+    initlockunlisted(&ptable.proc[i].lock, "proc");
+    ptable.proc[i].slot = i;
+    ptable.proc[i].freenext = ptable.freelist;
+    ptable.freelist = &ptable.proc[i];
   }
+  for(int i = 0; i < nhash; i++)
+    initlockunlisted(&ptable.sleepq[i].lock, "sleepq");
 }
 
 // Must be called with interrupts disabled
@@ -84,6 +146,94 @@ myproc(void) {
   return p;
 }
 
+// Pid index: every allocated slot, from allocproc() until
+// wait() frees it, is chained in the bucket for its pid.
+// Callers of pidhashadd() and pidhashdel() must not hold p->lock.
+static void
+pidhashadd(struct proc *p)
+{
+  struct proc **b = &ptable.pidhash[p->pid % nhash];
+
+  acquire(&ptable.pidlock);
+  p->pidnext = *b;
+  *b = p;
+  release(&ptable.pidlock);
+}
+
+static void
+pidhashdel(struct proc *p)
+{
+  struct proc **pp;
+
+  acquire(&ptable.pidlock);
+  for(pp = &ptable.pidhash[p->pid % nhash]; *pp; pp = &(*pp)->pidnext){
+    if(*pp == p){
+      *pp = p->pidnext;
+      break;
+    }
+  }
+  p->pidnext = 0;
+  release(&ptable.pidlock);
+}
+
+// Mark p UNUSED and put its slot back on the free list.
+// p->lock must be held.
+static void
+freeproc(struct proc *p)
+{
+  p->state = UNUSED;
+  acquire(&ptable.freelock);
+  p->freenext = ptable.freelist;
+  ptable.freelist = p;
+  release(&ptable.freelock);
+}
+
+// Child lists: each process links its live and zombie
+// children through sibnext/sibprev so that wait() and exit()
+// touch only them.  ptable.lock must be held.
+static void
+childadd(struct proc *parent, struct proc *p)
+{
+  p->parent = parent;
+  p->sibprev = 0;
+  p->sibnext = parent->children;
+  if(parent->children)
+    parent->children->sibprev = p;
+  parent->children = p;
+}
+
+static void
+childdel(struct proc *p)
+{
+  if(p->sibprev)
+    p->sibprev->sibnext = p->sibnext;
+  else
+    p->parent->children = p->sibnext;
+  if(p->sibnext)
+    p->sibnext->sibprev = p->sibprev;
+  p->sibnext = p->sibprev = 0;
+  p->parent = 0;
+}
+
+// Return the allocated process with the given pid with its
+// lock held, or 0.
+static struct proc*
+findproc(int pid)
+{
+  struct proc *p;
+
+  if(pid <= 0)
+    return 0;
+  acquire(&ptable.pidlock);
+  for(p = ptable.pidhash[pid % nhash]; p; p = p->pidnext)
+    if(p->pid == pid)
+      break;
+  if(p)
+    acquire(&p->lock);
+  release(&ptable.pidlock);
+  return p;
+}
+
 //PAGEBREAK: 32
 // Look in the process table for an UNUSED proc.
 // If found, change state to EMBRYO and initialize
@@ -140,20 +290,27 @@ allocproc(void)
   struct proc *p;
   char *sp;
 
-  acquire(&ptable.lock);
-
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    if(p->state == UNUSED)
-      goto found;
-
-  release(&ptable.lock);
-  return 0;
+  acquire(&ptable.freelock);
+  if((p = ptable.freelist) != 0)
+    ptable.freelist = p->freenext;
+  release(&ptable.freelock);
+  if(p == 0)
+    return 0;
 
-found:
+  acquire(&p->lock);
   p->state = EMBRYO;
-  p->pid = nextpid++;
+  p->pid = __sync_fetch_and_add(&nextpid, 1);
+  trace(TR_FORK, p->pid, myproc() ? myproc()->pid : 0);
   p->runticks = 0;
   p->tickets = DEFAULT_TICKETS;
+  p->cpu = cpuid();  // Queue on the creating CPU; others steal.
+  p->clockcpu = p->cpu;
+  p->cpumask = (1 << ncpu) - 1;
+  p->lastcpu = -1;
+  p->nmigrate = 0;
+  p->priority = 0;
+  p->slice = 0;
+  p->quantum = 0;
   
   // Initialize performance metrics
   acquire(&tickslock);
@@ -163,13 +320,22 @@ found:
   p->completion_time = 0;
   p->total_run_time = 0;
   p->total_ready_time = 0;
+  p->total_sleep_time = 0;
+  p->num_run = 0;
   p->enqueue_time = 0;
+  p->tsc_create = rdtsc();
+  p->tsc_start = p->tsc_done = 0;
+  p->tsc_run = p->tsc_ready = p->tsc_sleep = 0;
   
-  release(&ptable.lock);
+  release(&p->lock);
+  pidhashadd(p);
 
   // Allocate kernel stack.
   if((p->kstack = kalloc()) == 0){
-    p->state = UNUSED;
+    pidhashdel(p);
+    acquire(&p->lock);
+    freeproc(p);
+    release(&p->lock);
     return 0;
   }
   sp = p->kstack + KSTACKSIZE;
@@ -224,17 +390,20 @@ userinit(void)
   // run this process. the acquire forces the above
   // writes to be visible, and the lock is also needed
   // because the assignment might not be atomic.
-  acquire(&ptable.lock);
+  acquire(&p->lock);
 
-  p->state = RUNNABLE;
+  setrunnable(p);
 
-  release(&ptable.lock);
+  release(&p->lock);
 }
 
 
 
 
-// Grow current process's memory by n bytes.
+// Grow current process's memory by n bytes.  Growth only
+// reserves the addresses; uvmfault() fills each page in when
+// it is first touched.  Growing by more than the free memory
+// fails, as it did when the pages were allocated here.
 // Return 0 on success, -1 on failure.
 int
 growproc(int n)
@@ -244,8 +413,11 @@ growproc(int n)
 
   sz = curproc->sz;
   if(n > 0){
-    if((sz = allocuvm(curproc->pgdir, sz, sz + n)) == 0)
+    if(sz + n >= KERNBASE || sz + n < sz)
       return -1;
+    if((PGROUNDUP(sz + n) - PGROUNDUP(sz)) / PGSIZE > kfreepages())
+      return -1;
+    sz += n;
   } else if(n < 0){
     if((sz = deallocuvm(curproc->pgdir, sz, sz + n)) == 0)
       return -1;
@@ -274,13 +446,20 @@ fork(void)
   if((np->pgdir = copyuvm(curproc->pgdir, curproc->sz)) == 0){
     kfree(np->kstack);
     np->kstack = 0;
-    np->state = UNUSED;
+    pidhashdel(np);
+    acquire(&np->lock);
+    freeproc(np);
+    release(&np->lock);
     return -1;
   }
   np->sz = curproc->sz;
-  np->parent = curproc;
   *np->tf = *curproc->tf;
   np->tickets = curproc->tickets;  // Copy parent's tickets to child
+  np->pass = curproc->pass;  // Start level with the parent under STRIDE
+  np->vruntime = curproc->vruntime;  // and under CFS
+  np->clockcpu = curproc->clockcpu;
+  np->cpumask = curproc->cpumask;
+  np->quantum = curproc->quantum;
 
   // Clear %eax so that fork returns 0 in the child.
   np->tf->eax = 0;
@@ -295,12 +474,13 @@ fork(void)
   pid = np->pid;
 
   acquire(&ptable.lock);
-  acquire(&tickslock);
-  np->enqueue_time = ticks;  // Record when process enters ready queue
-  release(&tickslock);
-  np->state = RUNNABLE;
+  childadd(curproc, np);
   release(&ptable.lock);
 
+  acquire(&np->lock);
+  setrunnable(np);
+  release(&np->lock);
+
   return pid;
 }
 
@@ -312,13 +492,13 @@ exit(void)
 {
   struct proc *curproc = myproc();
   struct proc *p;
-  int fd;
+  int fd, orphans;
 
   if(curproc == initproc)
     panic("init exiting");
 
   // Finalize all metrics before doing anything else
-  acquire(&ptable.lock);
+  acquire(&curproc->lock);
   if(curproc->completion_time <= curproc->creation_time) {
     curproc->completion_time = ticks;  // Set completion time if not already set properly
   }
@@ -329,23 +509,7 @@ exit(void)
     curproc->total_ready_time += ticks - curproc->enqueue_time;
     curproc->enqueue_time = 0;
   }
-
-  // Store metrics in historical data
-  acquire(&perf_lock);
-  for(int i = 0; i < NPROC; i++) {
-    if(!perf_data[i].valid) {
-      perf_data[i].pid = curproc->pid;
-      perf_data[i].creation_time = curproc->creation_time;
-      perf_data[i].start_time = curproc->start_time;
-      perf_data[i].completion_time = curproc->completion_time;
-      perf_data[i].total_run_time = curproc->total_run_time;
-      perf_data[i].total_ready_time = curproc->total_ready_time;
-      perf_data[i].valid = 1;
-      break;
-    }
-  }
-  release(&perf_lock);
-  release(&ptable.lock);
+  release(&curproc->lock);
 
   // Close all open files.
   for(fd = 0; fd < NOFILE; fd++){
@@ -363,19 +527,23 @@ exit(void)
   acquire(&ptable.lock);
 
   // Parent might be sleeping in wait().
-  wakeup1(curproc->parent);
+  wakeup(curproc->parent);
 
   // Pass abandoned children to init.
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->parent == curproc){
-      p->parent = initproc;
-      if(p->state == ZOMBIE)
-        wakeup1(initproc);
-    }
+  orphans = curproc->children != 0;
+  while((p = curproc->children) != 0){
+    childdel(p);
+    childadd(initproc, p);
   }
+  if(orphans)
+    wakeup(initproc);
 
-  // Jump into the scheduler, never to return.
+  // Jump into the scheduler, never to return.  The parent's
+  // wait() can't free us until scheduler() releases our lock.
+  acquire(&curproc->lock);
+  trace(TR_EXIT, curproc->pid, curproc->parent->pid);
   curproc->state = ZOMBIE;
+  release(&ptable.lock);
   sched();
   panic("zombie exit");
 }
@@ -393,12 +561,10 @@ wait(void)
   
   acquire(&ptable.lock);
   for(;;){
-    // Scan through table looking for exited children.
-    havekids = 0;
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->parent != curproc)
-        continue;
-      havekids = 1;
+    // Scan through our children looking for exited ones.
+    havekids = curproc->children != 0;
+    for(p = curproc->children; p; p = p->sibnext){
+      acquire(&p->lock);
       if(p->state == ZOMBIE){
         // Found one.
         pid = p->pid;
@@ -414,43 +580,28 @@ wait(void)
           p->total_ready_time += ticks - p->enqueue_time;
           p->enqueue_time = 0;
         }
-        
-        // Store performance metrics before cleanup
-        acquire(&perf_lock);
-        int stored = 0;
-        for(int i = 0; i < NPROC; i++) {
-          if(!perf_data[i].valid) {
-            perf_data[i].pid = p->pid;
-            perf_data[i].creation_time = p->creation_time;
-            perf_data[i].start_time = p->start_time;
-            perf_data[i].completion_time = p->completion_time;
-            perf_data[i].total_run_time = p->total_run_time;
-            perf_data[i].total_ready_time = p->total_ready_time;
-            perf_data[i].valid = 1;
-            stored = 1;
-            break;
-          }
-        }
-        release(&perf_lock);
 
-        // If we couldn't store metrics, wait and try again
-        if(!stored) {
-          continue;
-        }
+        // scheduler() has already logged its completion record.
 
-        // Clean up process
+        // Clean up process.  Only we can free a zombie
+        // child, so it can be unlocked for pidhashdel().
+        release(&p->lock);
+        pidhashdel(p);
+        childdel(p);
+        acquire(&p->lock);
         kfree(p->kstack);
         p->kstack = 0;
         freevm(p->pgdir);
         p->pid = 0;
-        p->parent = 0;
         p->name[0] = 0;
         p->killed = 0;
-        p->state = UNUSED;
+        freeproc(p);
+        release(&p->lock);
 
         release(&ptable.lock);
         return pid;
       }
+      release(&p->lock);
     }
 
     // No point waiting if we don't have any children.
@@ -459,7 +610,7 @@ wait(void)
       return -1;
     }
 
-    // Wait for children to exit.  (See wakeup1 call in proc_exit.)
+    // Wait for children to exit.  (See wakeup call in exit.)
     sleep(curproc, &ptable.lock);  //DOC: wait-sleep
   }
 }
@@ -512,234 +663,119 @@ wait(void)
 
 
 
-void scheduler(void)
+// Halt this CPU until an interrupt arrives, such as the IPI
+// rqadd() sends when it queues work an idle CPU could run.
+// CPU 0 keeps its timer running because it advances ticks;
+// the others stop theirs so an idle CPU costs nothing.
+static void
+idle(struct cpu *c)
 {
-#ifdef SCHEDULER_LOTTERY
-    struct proc *p;
-    struct cpu *c = mycpu();
-    int total_tickets;
-    int winning_ticket;
-
-    c->proc = 0;
-
-    for(;;) {
-        sti();
-        acquire(&ptable.lock);
-        total_tickets = 0;
-
-        // Update metrics for all processes first
-        for(p = ptable.proc; p < &ptable.proc[NPROC]; p++) {
-            // Update completion time for any process that's done
-            if((p->state == ZOMBIE || p->state == UNUSED) && p->completion_time <= p->creation_time) {
-                acquire(&tickslock);
-                p->completion_time = ticks;
-                release(&tickslock);
-                if(p->total_run_time == 0) {
-                    p->total_run_time = 1;  // Ensure minimum run time
-                }
-                // Store metrics immediately for completed processes
-                acquire(&perf_lock);
-                for(int i = 0; i < NPROC; i++) {
-                    if(!perf_data[i].valid) {
-                        perf_data[i].pid = p->pid;
-                        perf_data[i].creation_time = p->creation_time;
-                        perf_data[i].start_time = p->start_time;
-                        perf_data[i].completion_time = p->completion_time;
-                        perf_data[i].total_run_time = p->total_run_time;
-                        perf_data[i].total_ready_time = p->total_ready_time;
-                        perf_data[i].valid = 1;
-                        break;
-                    }
-                }
-                release(&perf_lock);
-            }
-            // Update ready time for RUNNABLE processes
-            if(p->state == RUNNABLE && p->enqueue_time > 0) {
-                acquire(&tickslock);
-                p->total_ready_time += ticks - p->enqueue_time;
-                p->enqueue_time = ticks;  // Reset enqueue time to prevent double counting
-                release(&tickslock);
-            }
-        }
+  cli();
+  c->idle = 1;
+  // Pairs with the barrier in rqadd()'s release: either we see
+  // the new work here or rqadd() sees c->idle and sends the IPI.
+  __sync_synchronize();
+  if(!rqready(c)){
+    if(c != &cpus[0])
+      lapictimer(0);
+    stihlt();
+    cli();
+    if(c != &cpus[0])
+      lapictimer(1);
+  }
+  c->idle = 0;
+  sti();
+}
 
-        for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-            if(p->state == RUNNABLE)
-                total_tickets += p->tickets;
-        }
+void
+scheduler(void)
+{
+  struct proc *p;
+  struct cpu *c = mycpu();
+  uint run_start;
+  uint64 tsc;
 
-        if(total_tickets > 0){
-            winning_ticket = get_random(0, total_tickets);
-            int current_count = 0;
-            for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-                if(p->state != RUNNABLE)
-                    continue;
-                current_count += p->tickets;
-                if(current_count > winning_ticket)
-                    break;
-            }
-
-            if(p->state == RUNNABLE) {
-                c->proc = p;
-                switchuvm(p);
-                p->state = RUNNING;
-
-                // Update metrics before running
-                if(p->enqueue_time > 0) {
-                    acquire(&tickslock);
-                    p->total_ready_time += ticks - p->enqueue_time;
-                    p->enqueue_time = 0;  // Clear enqueue time while running
-                    release(&tickslock);
-                }
-                acquire(&tickslock);
-                uint run_start = ticks;
-                release(&tickslock);
-
-                swtch(&(c->scheduler), p->context);
-                switchkvm();
-
-                // Update metrics after running
-                acquire(&tickslock);
-                uint run_time = ticks - run_start;
-                release(&tickslock);
-                // Always count at least 1 tick for any process that gets CPU time
-                if(run_time == 0) {
-                    run_time = 1;
-                }
-                p->total_run_time += run_time;
-                p->runticks += run_time;
-
-                // Update completion time if process is done
-                if(p->state == ZOMBIE || p->state == UNUSED) {
-                    acquire(&tickslock);
-                    p->completion_time = ticks;
-                    last_completion_time = p->completion_time;  // Update last completion time
-                    release(&tickslock);
-                    // Store metrics immediately
-                    acquire(&perf_lock);
-                    for(int i = 0; i < NPROC; i++) {
-                        if(!perf_data[i].valid) {
-                            perf_data[i].pid = p->pid;
-                            perf_data[i].creation_time = p->creation_time;
-                            perf_data[i].start_time = p->start_time;
-                            perf_data[i].completion_time = p->completion_time;
-                            perf_data[i].total_run_time = p->total_run_time;
-                            perf_data[i].total_ready_time = p->total_ready_time;
-                            perf_data[i].valid = 1;
-                            break;
-                        }
-                    }
-                    release(&perf_lock);
-                }
-                
-                c->proc = 0;
-            }
-        }
-        release(&ptable.lock);
-    }
-#elif defined(SCHEDULER_FIFO)
-    struct proc *p;
-    struct cpu *c = mycpu();
-    c->proc = 0;
-
-    for (;;) {
-        sti();
-        acquire(&ptable.lock);
-        p = ptable.head;
-        
-        if (p && p->state == RUNNABLE) {
-            c->proc = p;
-            switchuvm(p);
-            p->state = RUNNING;
-
-            // Update metrics
-            if (p->enqueue_time > 0) {
-                acquire(&tickslock);
-                p->total_ready_time += ticks - p->enqueue_time;
-                release(&tickslock);
-            }
-            acquire(&tickslock);
-            uint run_start = ticks;
-            release(&tickslock);
-
-            swtch(&(c->scheduler), p->context);
-            switchkvm();
-
-            acquire(&tickslock);
-            p->total_run_time += ticks - run_start;
-            release(&tickslock);
-            c->proc = 0;
-
-            if (p->state == ZOMBIE) {
-                acquire(&tickslock);
-                p->completion_time = ticks;
-                last_completion_time = p->completion_time;
-                release(&tickslock);
-                if(p->next && p->next->state == RUNNABLE) {
-                    ptable.head = p->next;
-                }
-            }
-        } else if(p && p->next && p->next->state == RUNNABLE) {
-            ptable.head = p->next;
-        }
-        release(&ptable.lock);
-    }
-#else
-    struct proc *p;
-    struct cpu *c = mycpu();
-    c->proc = 0;
-
-    for(;;) {
-        sti();
-        acquire(&ptable.lock);
-
-        for(p = ptable.proc; p < &ptable.proc[NPROC]; p++) {
-            if(p->state != RUNNABLE)
-                continue;
-
-            c->proc = p;
-            switchuvm(p);
-            p->state = RUNNING;
-            
-            // Set start time to last completion time if not already set
-            if (p->start_time == 0) {
-                p->start_time = last_completion_time;
-            }
-
-            // Update metrics
-            if (p->enqueue_time > 0) {
-                p->total_ready_time += ticks - p->enqueue_time;
-            }
-            acquire(&tickslock);
-            uint run_start = ticks;
-            release(&tickslock);
-            
-            swtch(&(c->scheduler), p->context);
-            switchkvm();
-            
-            p->total_run_time += ticks - run_start;
-
-            // Update completion time if process is done
-            if(p->state == ZOMBIE || p->state == UNUSED) {
-                acquire(&tickslock);
-                p->completion_time = ticks;
-                last_completion_time = p->completion_time;  // Update last completion time
-                release(&tickslock);
-            }
-            
-            c->proc = 0;
-        }
-        release(&ptable.lock);
+  c->proc = 0;
+
+  for(;;){
+    // Enable interrupts on this processor.
+    sti();
+
+    // Only touch the run queue locks once some queue has work,
+    // so idle CPUs don't fight the busy ones for them.
+    if(!rqready(c)){
+      c->swtchstart = 0;  // don't count idle time as switch cost
+      idle(c);
+      continue;
     }
-#endif
-  }
 
+    if((p = rqpick(c)) != 0){
+      // If p is still on its way out of another CPU, this
+      // waits until that CPU's scheduler has switched away.
+      acquire(&p->lock);
+      if(p->state != RUNNABLE)
+        panic("scheduler");
+
+      // Its affinity changed while it was queued here.
+      if(!(p->cpumask & (1 << (c - cpus)))){
+        rqadd(p);
+        release(&p->lock);
+        continue;
+      }
 
+      // Switch to chosen process.  It is the process's job
+      // to release p->lock and then reacquire it
+      // before jumping back to us.
+      c->proc = p;
+      trace(TR_RUN, p->pid, p->lastcpu);
+      p->cpu = c - cpus;
+      if(p->lastcpu >= 0 && p->lastcpu != p->cpu){
+        p->nmigrate++;
+        c->nmigrate++;
+      }
+      p->lastcpu = p->cpu;
+      switchuvm(p);
+      p->state = RUNNING;
+      p->num_run++;
+
+      // Set start time to last completion time if not already set
+      if(p->start_time == 0)
+        p->start_time = last_completion_time;
+
+      // Update metrics
+      if(p->enqueue_time > 0){
+        p->total_ready_time += ticks - p->enqueue_time;
+        p->enqueue_time = 0;
+      }
+      run_start = ticks;
+      tsc = rdtsc();
+      if(p->tsc_start == 0)
+        p->tsc_start = tsc;
+      p->tsc_ready += tsc - p->tsc_mark;
 
+      swtch(&(c->scheduler), p->context);
+      switchkvm();
 
+      p->total_run_time += ticks - run_start;
+      p->tsc_run += rdtsc() - tsc;
 
+      // Update completion time if process is done
+      if(p->state == ZOMBIE){
+        p->completion_time = ticks;
+        p->tsc_done = rdtsc();
+        last_completion_time = p->completion_time;
+        perfrecord(p);
+      }
 
+      // Process is done running for now.
+      // It should have changed its p->state before coming back.
+      c->proc = 0;
+      release(&p->lock);
+    }
+  }
+}
 
-// Enter scheduler.  Must hold only ptable.lock
+// Enter scheduler.  Must hold only p->lock
 // and have changed proc->state. Saves and restores
 // intena because intena is a property of this
 // kernel thread, not this CPU. It should
@@ -752,8 +788,8 @@ sched(void)
   int intena;
   struct proc *p = myproc();
 
-  if(!holding(&ptable.lock))
-    panic("sched ptable.lock");
+  if(!holding(&p->lock))
+    panic("sched p->lock");
   if(mycpu()->ncli != 1)
     panic("sched locks");
   if(p->state == RUNNING)
@@ -761,22 +797,37 @@ sched(void)
   if(readeflags()&FL_IF)
     panic("sched interruptible");
   intena = mycpu()->intena;
+  trace(TR_SWITCH, p->pid, p->state);
+  mycpu()->swtchstart = rdtsc();
   swtch(&p->context, mycpu()->scheduler);
+  swtchdone();
   mycpu()->intena = intena;
 }
 
+// Charge the time since the last process on this CPU entered
+// sched() to context-switch cost.  Interrupts are off.
+static void
+swtchdone(void)
+{
+  struct cpu *c = mycpu();
+
+  if(c->swtchstart){
+    c->swtchcycles += rdtsc() - c->swtchstart;
+    c->nswtch++;
+    c->swtchstart = 0;
+  }
+}
+
 // Give up the CPU for one scheduling round.
 void
 yield(void)
 {
   struct proc *p = myproc();
-  acquire(&ptable.lock);
-  p->state = RUNNABLE;
-  acquire(&tickslock);
-  p->enqueue_time = ticks;  // Record when process enters ready queue
-  release(&tickslock);
+
+  acquire(&p->lock);  //DOC: yieldlock
+  setrunnable(p);
   sched();
-  release(&ptable.lock);
+  release(&p->lock);
 }
 
 // A fork child's very first scheduling by scheduler()
@@ -785,8 +836,9 @@ void
 forkret(void)
 {
   static int first = 1;
-  // Still holding ptable.lock from scheduler.
-  release(&ptable.lock);
+  // Still holding p->lock from scheduler.
+  swtchdone();
+  release(&myproc()->lock);
 
   if (first) {
     // Some initialization functions must be run in the context
@@ -806,6 +858,7 @@ void
 sleep(void *chan, struct spinlock *lk)
 {
   struct proc *p = myproc();
+  struct sleepq *q;
   
   if(p == 0)
     panic("sleep");
@@ -813,16 +866,16 @@ sleep(void *chan, struct spinlock *lk)
   if(lk == 0)
     panic("sleep without lk");
 
-  // Must acquire ptable.lock in order to
-  // change p->state and then call sched.
-  // Once we hold ptable.lock, we can be
-  // guaranteed that we won't miss any wakeup
-  // (wakeup runs with ptable.lock locked),
+  // Must acquire p->lock in order to change p->state
+  // and then call sched, and chan's bucket lock to
+  // queue p there.  Once we hold the bucket lock, we
+  // can be guaranteed that we won't miss any wakeup
+  // (wakeup runs with the bucket locked),
   // so it's okay to release lk.
-  if(lk != &ptable.lock){  //DOC: sleeplock0
-    acquire(&ptable.lock);  //DOC: sleeplock1
-    release(lk);
-  }
+  q = sleepq(chan);
+  acquire(&q->lock);  //DOC: sleeplock1
+  acquire(&p->lock);
+  release(lk);
 
   // Update metrics before sleeping
   if(p->enqueue_time > 0) {
@@ -833,6 +886,10 @@ sleep(void *chan, struct spinlock *lk)
   // Go to sleep.
   p->chan = chan;
   p->state = SLEEPING;
+  p->sleep_start = ticks;
+  p->tsc_mark = rdtsc();
+  sleepqadd(p);
+  release(&q->lock);
 
   sched();
 
@@ -840,34 +897,159 @@ sleep(void *chan, struct spinlock *lk)
   p->chan = 0;
 
   // Reacquire original lock.
-  if(lk != &ptable.lock){  //DOC: sleeplock2
-    release(&ptable.lock);
-    acquire(lk);
-  }
+  release(&p->lock);  //DOC: sleeplock2
+  acquire(lk);
 }
 
 //PAGEBREAK!
-// Wake up all processes sleeping on chan.
-// The ptable lock must be held.
+// Wait-channel hash bucket for chan.  Channels are aligned
+// kernel addresses, so use the well-mixed middle bits of a
+// multiplicative hash rather than the low ones.
+static struct sleepq*
+sleepq(void *chan)
+{
+  return &ptable.sleepq[(((uint)chan * 2654435761u) >> 16) % nhash];
+}
+
+// Add sleeping p to the bucket for p->chan.
+// The bucket lock must be held.
 static void
-wakeup1(void *chan)
+sleepqadd(struct proc *p)
 {
-  struct proc *p;
+  struct sleepq *q = sleepq(p->chan);
 
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    if(p->state == SLEEPING && p->chan == chan){
-       p->state = RUNNABLE;
-       p->enqueue_time = ticks;
-    }
+  p->sqprev = 0;
+  p->sqnext = q->head;
+  if(q->head)
+    q->head->sqprev = p;
+  q->head = p;
+}
+
+// Remove p from its wait-channel bucket.
+// The bucket lock must be held.
+static void
+sleepqdel(struct proc *p)
+{
+  if(p->sqprev)
+    p->sqprev->sqnext = p->sqnext;
+  else
+    sleepq(p->chan)->head = p->sqnext;
+  if(p->sqnext)
+    p->sqnext->sqprev = p->sqprev;
+  p->sqnext = p->sqprev = 0;
+}
+
+// Make p RUNNABLE and queue it on the run queue of the
+// CPU it last ran on.  p->lock must be held, and if p is
+// SLEEPING, so must the lock of its wait-channel bucket.
+static void
+setrunnable(struct proc *p)
+{
+  uint64 tsc = rdtsc();
+
+  if(p->state == SLEEPING){
+    sleepqdel(p);
+    p->total_sleep_time += ticks - p->sleep_start;
+    p->tsc_sleep += tsc - p->tsc_mark;
+    trace(TR_WAKEUP, p->pid, myproc() ? myproc()->pid : 0);
+  }
+  p->tsc_mark = tsc;
+  p->state = RUNNABLE;
+  p->enqueue_time = ticks;  // Record when process enters ready queue
+  rqadd(p);
 }
 
 // Wake up all processes sleeping on chan.
+// Only the processes hashed to chan's bucket are examined.
 void
 wakeup(void *chan)
 {
-  acquire(&ptable.lock);
-  wakeup1(chan);
-  release(&ptable.lock);
+  struct sleepq *q = sleepq(chan);
+  struct proc *p, *next;
+
+  acquire(&q->lock);
+  for(p = q->head; p; p = next){
+    next = p->sqnext;
+    if(p->chan == chan){
+      acquire(&p->lock);
+      setrunnable(p);
+      release(&p->lock);
+    }
+  }
+  release(&q->lock);
+}
+
+// Timer wheel slot for deadline.
+static struct proc**
+timerq(uint deadline)
+{
+  return &ptable.timerq[deadline % nhash];
+}
+
+// Remove p from the timer wheel.
+// ptable.tqlock must be held.
+static void
+timerqdel(struct proc *p)
+{
+  if(p->tqprev)
+    p->tqprev->tqnext = p->tqnext;
+  else
+    *timerq(p->deadline) = p->tqnext;
+  if(p->tqnext)
+    p->tqnext->tqprev = p->tqprev;
+  p->tqnext = p->tqprev = 0;
+  p->intimerq = 0;
+}
+
+// Sleep until ticks reaches deadline.  The process waits in
+// the timer wheel slot for its deadline, so each clock tick
+// wakes only the processes whose time has come instead of
+// every sleeper.  Returns -1 if killed first, else 0.
+int
+sleepuntil(uint deadline)
+{
+  struct proc *p = myproc();
+  struct proc **q;
+
+  acquire(&ptable.tqlock);
+  while((int)(ticks - deadline) < 0){
+    if(p->killed){
+      release(&ptable.tqlock);
+      return -1;
+    }
+    p->deadline = deadline;
+    q = timerq(deadline);
+    p->tqprev = 0;
+    p->tqnext = *q;
+    if(*q)
+      (*q)->tqprev = p;
+    *q = p;
+    p->intimerq = 1;
+    sleep(&p->deadline, &ptable.tqlock);
+    // Still queued if woken by kill() rather than timerwake().
+    if(p->intimerq)
+      timerqdel(p);
+  }
+  release(&ptable.tqlock);
+  return 0;
+}
+
+// Wake the processes whose deadline is now.  Called by
+// CPU 0 after it advances ticks to now.
+void
+timerwake(uint now)
+{
+  struct proc *p, *next;
+
+  acquire(&ptable.tqlock);
+  for(p = *timerq(now); p; p = next){
+    next = p->tqnext;
+    if((int)(now - p->deadline) >= 0){
+      timerqdel(p);
+      wakeup(&p->deadline);
+    }
+  }
+  release(&ptable.tqlock);
 }
 
 // Kill the process with the given pid.
@@ -877,20 +1059,54 @@ int
 kill(int pid)
 {
   struct proc *p;
+  struct sleepq *q;
+  void *chan;
 
-  acquire(&ptable.lock);
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->pid == pid){
-      p->killed = 1;
-      // Wake process from sleep if necessary.
-      if(p->state == SLEEPING)
-        p->state = RUNNABLE;
-      release(&ptable.lock);
-      return 0;
-    }
+  if((p = findproc(pid)) == 0)
+    return -1;
+  p->killed = 1;
+  // Wake process from sleep if necessary.  Its bucket lock
+  // comes before p->lock, so let go and take both in order,
+  // then check p is still asleep on the same channel.
+  while(p->pid == pid && p->state == SLEEPING){
+    chan = p->chan;
+    release(&p->lock);
+    q = sleepq(chan);
+    acquire(&q->lock);
+    acquire(&p->lock);
+    if(p->pid == pid && p->state == SLEEPING && p->chan == chan)
+      setrunnable(p);
+    release(&q->lock);
   }
-  release(&ptable.lock);
-  return -1;
+  release(&p->lock);
+  return 0;
+}
+
+static void
+locksum(struct spinlock *sum, struct spinlock *lk)
+{
+  sum->nacquire += lk->nacquire;
+  sum->ncontend += lk->ncontend;
+  sum->spincycles += lk->spincycles;
+}
+
+// Fill sum with the counters of the process locks and of
+// the sleepq locks, each group added together, for
+// sys_lockstat(), which doesn't list them one by one.
+// Returns the number of entries, NLOCKSUM.
+// No locks: the counters are only statistics.
+int
+proclocks(struct spinlock *sum)
+{
+  int i;
+
+  initlockunlisted(&sum[0], "proc");
+  initlockunlisted(&sum[1], "sleepq");
+  for(i = 0; i < NPROC; i++)
+    locksum(&sum[0], &ptable.proc[i].lock);
+  for(i = 0; i < nhash; i++)
+    locksum(&sum[1], &ptable.sleepq[i].lock);
+  return NLOCKSUM;
 }
 
 //PAGEBREAK: 36
@@ -936,17 +1152,13 @@ int getrunticks(int pid) {
   struct proc *p;
   int val = -1;
 
-  acquire(&ptable.lock);
-  for (p = ptable.proc; p < &ptable.proc[NPROC]; p++) {
-    if (p->pid == pid) {
-      // 确保进程状态有效，防止访问无效内存
-      if (p->state != ZOMBIE && p->state != UNUSED) {
-        val = p->runticks;
-      }
-      break;
+  if ((p = findproc(pid)) != 0) {
+    // 确保进程状态有效，防止访问无效内存
+    if (p->state != ZOMBIE && p->state != UNUSED) {
+      val = p->runticks;
     }
+    release(&p->lock);
   }
-  release(&ptable.lock);
   return val;
 }
 
@@ -971,7 +1183,11 @@ sys_set_tickets(void) {
   if (argint(0, &t) < 0)
     return -1;
 
-  if (t <= 0) {
+  // Past MAXTICKETS the CFS increment, CFSSCALE*DEFAULT_TICKETS/t,
+  // would round to 0 and the process would hold its CPU; the STRIDE
+  // stride does the same past STRIDE1, and NPROC large counts could
+  // overflow a lottery queue's total.
+  if (t <= 0 || t > MAXTICKETS) {
     return -1;
   }
 
@@ -980,9 +1196,12 @@ sys_set_tickets(void) {
     return -1;
   }
 
-  acquire(&ptable.lock);
+  // p is RUNNING, so it is on no run queue and the lottery
+  // tree picks up the new count when p is next queued.
+  acquire(&p->lock);
   p->tickets = t;
-  release(&ptable.lock);
+  trace(TR_TICKETS, p->pid, t);
+  release(&p->lock);
   return 0;
 }
 
@@ -991,17 +1210,13 @@ int gettickets(int pid) {
   struct proc *p;
   int tickets_val = -1;
 
-  acquire(&ptable.lock);
-  for (p = ptable.proc; p < &ptable.proc[NPROC]; p++) {
-    if (p->pid == pid) { 
-      // 确保状态是 RUNNABLE, RUNNING，并且进程不是 ZOMBIE
-      if (p->state == RUNNABLE || p->state == RUNNING) {
-        tickets_val = p->tickets;
-      }
-      break;
+  if ((p = findproc(pid)) != 0) {
+    // 确保状态是 RUNNABLE, RUNNING，并且进程不是 ZOMBIE
+    if (p->state == RUNNABLE || p->state == RUNNING) {
+      tickets_val = p->tickets;
     }
+    release(&p->lock);
   }
-  release(&ptable.lock);
   return tickets_val;
 }
 
@@ -1016,17 +1231,170 @@ sys_get_tickets(void)
   return gettickets(pid);
 }
 
+// Set the caller's priority level; 0 is the highest.
+// Only SCHEDULER=MLFQ acts on it.
+int
+sys_set_priority(void)
+{
+  int prio;
+  struct proc *p = myproc();
+
+  if(argint(0, &prio) < 0)
+    return -1;
+  if(prio < 0 || prio >= NMLFQ)
+    return -1;
+
+  acquire(&p->lock);
+  p->priority = prio;
+  p->slice = 0;
+  release(&p->lock);
+  return 0;
+}
+
+int
+getpriority(int pid)
+{
+  struct proc *p;
+  int prio = -1;
+
+  if((p = findproc(pid)) != 0){
+    if(p->state != ZOMBIE)
+      prio = p->priority;
+    release(&p->lock);
+  }
+  return prio;
+}
+
+int
+sys_get_priority(void)
+{
+  int pid;
+  if(argint(0, &pid) < 0)
+    return -1;
+  return getpriority(pid);
+}
+
+// Let pid run only on the CPUs in mask, bit i for CPU i.
+// A queued process moves when a CPU next picks it, a running
+// one when it is next queued; a caller that has just barred
+// its own CPU yields at once so that it moves now.
+int
+setaffinity(int pid, uint mask)
+{
+  struct proc *p;
+  int move;
+
+  mask &= (1 << ncpu) - 1;
+  if(mask == 0)
+    return -1;
+  if((p = findproc(pid)) == 0)
+    return -1;
+  p->cpumask = mask;
+  move = p == myproc() && !(mask & (1 << cpuid()));
+  release(&p->lock);
+  if(move)
+    yield();
+  return 0;
+}
+
+int
+getaffinity(int pid)
+{
+  struct proc *p;
+  int mask = -1;
+
+  if((p = findproc(pid)) != 0){
+    mask = p->cpumask;
+    release(&p->lock);
+  }
+  return mask;
+}
+
+// Give pid a time slice of ticks, or if ticks is 0, the
+// policy default.  pid 0 names the default itself.
+int
+setquantum(int pid, int ticks)
+{
+  struct proc *p;
+
+  if(ticks < 0 || ticks > MAXQUANTUM)
+    return -1;
+  if(pid == 0){
+    if(ticks == 0)
+      return -1;
+    defquantum = ticks;
+    return 0;
+  }
+  if((p = findproc(pid)) == 0)
+    return -1;
+  p->quantum = ticks;
+  release(&p->lock);
+  return 0;
+}
+
+// The time slice pid runs with, or for pid 0 the default.
+int
+getquantum(int pid)
+{
+  struct proc *p;
+  int q = -1;
+
+  if(pid == 0)
+    return defquantum;
+  if((p = findproc(pid)) != 0){
+    q = p->quantum ? p->quantum : defquantum;
+    release(&p->lock);
+  }
+  return q;
+}
+
+int
+sys_setaffinity(void)
+{
+  int pid, mask;
+
+  if(argint(0, &pid) < 0 || argint(1, &mask) < 0)
+    return -1;
+  return setaffinity(pid, mask);
+}
+
+int
+sys_getaffinity(void)
+{
+  int pid;
+
+  if(argint(0, &pid) < 0)
+    return -1;
+  return getaffinity(pid);
+}
+
+int
+sys_setquantum(void)
+{
+  int pid, ticks;
+
+  if(argint(0, &pid) < 0 || argint(1, &ticks) < 0)
+    return -1;
+  return setquantum(pid, ticks);
+}
+
+int
+sys_getquantum(void)
+{
+  int pid;
+
+  if(argint(0, &pid) < 0)
+    return -1;
+  return getquantum(pid);
+}
+
 
 int job_position(int pid) {
   struct proc *p;
-  acquire(&ptable.lock);
-  for (p = ptable.proc; p < &ptable.proc[NPROC]; p++) {
-      if (p->pid == pid) {
-          release(&ptable.lock);
-          return p->pid;  
-      }
+  if ((p = findproc(pid)) != 0) {
+      release(&p->lock);
+      return pid;  
   }
-  release(&ptable.lock);
   return -1;  
 }
 
@@ -1034,27 +1402,18 @@ int
 get_creation_time(int pid)
 {
   struct proc *p;
+  struct perfrec r;
   int creation_time = -1;
 
-  acquire(&ptable.lock);
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++) {
-    if(p->pid == pid) {
-      creation_time = p->creation_time;
-      break;
-    }
+  if((p = findproc(pid)) != 0){
+    creation_time = p->creation_time;
+    release(&p->lock);
   }
-  release(&ptable.lock);
   
   if(creation_time == -1) {
     // Look in historical data
-    acquire(&perf_lock);
-    for(int i = 0; i < NPROC; i++) {
-      if(perf_data[i].valid && perf_data[i].pid == pid) {
-        creation_time = perf_data[i].creation_time;
-        break;
-      }
-    }
-    release(&perf_lock);
+    if(perflookup(pid, &r) == 0)
+      creation_time = r.creation_time;
   }
   
   return creation_time;
@@ -1064,27 +1423,18 @@ int
 get_start_time(int pid)
 {
   struct proc *p;
+  struct perfrec r;
   int start_time = -1;
 
-  acquire(&ptable.lock);
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++) {
-    if(p->pid == pid) {
-      start_time = p->start_time;
-      break;
-    }
+  if((p = findproc(pid)) != 0){
+    start_time = p->start_time;
+    release(&p->lock);
   }
-  release(&ptable.lock);
   
   if(start_time == -1) {
     // Look in historical data
-    acquire(&perf_lock);
-    for(int i = 0; i < NPROC; i++) {
-      if(perf_data[i].valid && perf_data[i].pid == pid) {
-        start_time = perf_data[i].start_time;
-        break;
-      }
-    }
-    release(&perf_lock);
+    if(perflookup(pid, &r) == 0)
+      start_time = r.start_time;
   }
   
   return start_time;
@@ -1094,27 +1444,18 @@ int
 get_completion_time(int pid)
 {
   struct proc *p;
+  struct perfrec r;
   int completion_time = -1;
 
-  acquire(&ptable.lock);
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++) {
-    if(p->pid == pid) {
-      completion_time = p->completion_time;
-      break;
-    }
+  if((p = findproc(pid)) != 0){
+    completion_time = p->completion_time;
+    release(&p->lock);
   }
-  release(&ptable.lock);
   
   if(completion_time == -1) {
     // Look in historical data
-    acquire(&perf_lock);
-    for(int i = 0; i < NPROC; i++) {
-      if(perf_data[i].valid && perf_data[i].pid == pid) {
-        completion_time = perf_data[i].completion_time;
-        break;
-      }
-    }
-    release(&perf_lock);
+    if(perflookup(pid, &r) == 0)
+      completion_time = r.completion_time;
   }
   
   return completion_time;
@@ -1124,27 +1465,18 @@ int
 get_total_run_time(int pid)
 {
   struct proc *p;
+  struct perfrec r;
   int total_run_time = -1;
 
-  acquire(&ptable.lock);
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++) {
-    if(p->pid == pid) {
-      total_run_time = p->total_run_time;
-      break;
-    }
+  if((p = findproc(pid)) != 0){
+    total_run_time = p->total_run_time;
+    release(&p->lock);
   }
-  release(&ptable.lock);
   
   if(total_run_time == -1) {
     // Look in historical data
-    acquire(&perf_lock);
-    for(int i = 0; i < NPROC; i++) {
-      if(perf_data[i].valid && perf_data[i].pid == pid) {
-        total_run_time = perf_data[i].total_run_time;
-        break;
-      }
-    }
-    release(&perf_lock);
+    if(perflookup(pid, &r) == 0)
+      total_run_time = r.total_run_time;
   }
   
   return total_run_time;
@@ -1154,29 +1486,140 @@ int
 get_total_ready_time(int pid)
 {
   struct proc *p;
+  struct perfrec r;
   int total_ready_time = -1;
 
-  acquire(&ptable.lock);
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++) {
-    if(p->pid == pid) {
-      total_ready_time = p->total_ready_time;
-      break;
-    }
+  if((p = findproc(pid)) != 0){
+    total_ready_time = p->total_ready_time;
+    release(&p->lock);
   }
-  release(&ptable.lock);
   
   if(total_ready_time == -1) {
     // Look in historical data
-    acquire(&perf_lock);
-    for(int i = 0; i < NPROC; i++) {
-      if(perf_data[i].valid && perf_data[i].pid == pid) {
-        total_ready_time = perf_data[i].total_ready_time;
-        break;
-      }
-    }
-    release(&perf_lock);
+    if(perflookup(pid, &r) == 0)
+      total_ready_time = r.total_ready_time;
   }
   
   return total_ready_time;
 }
 
+// Copy statistics for up to max processes to buf: first every
+// allocated process, then the completion history of processes
+// already reaped that are still in the completion rings.
+// Returns the number of entries.
+int
+getprocstats(struct procstat *buf, int max)
+{
+  struct proc *p;
+  struct perfrec d;
+  struct procstat *s;
+  int c, i, n;
+
+  n = 0;
+  for(p = ptable.proc; p < &ptable.proc[NPROC] && n < max; p++){
+    acquire(&p->lock);
+    if(p->state == UNUSED){
+      release(&p->lock);
+      continue;
+    }
+    s = &buf[n++];
+    s->pid = p->pid;
+    s->state = p->state;
+    safestrcpy(s->name, p->name, sizeof(s->name));
+    s->tickets = p->tickets;
+    s->priority = p->priority;
+    s->runticks = p->runticks;
+    s->num_run = p->num_run;
+    s->nmigrate = p->nmigrate;
+    s->creation_time = p->creation_time;
+    s->start_time = p->start_time;
+    s->completion_time = p->completion_time;
+    s->total_run_time = p->total_run_time;
+    s->total_ready_time = p->total_ready_time;
+    s->total_sleep_time = p->total_sleep_time;
+    s->run_ns = tsc2ns(p->tsc_run);
+    s->ready_ns = tsc2ns(p->tsc_ready);
+    s->sleep_ns = tsc2ns(p->tsc_sleep);
+    release(&p->lock);
+  }
+  for(c = 0; c < ncpu; c++){
+    for(i = 0; i < NPERFREC && n < max; i++){
+      // Skip records not yet written or caught mid-update,
+      // not the rest of the ring.
+      if(perfget(c, i, &d) < 0)
+        continue;
+      // A zombie's record is already reported from ptable.
+      if((p = findproc(d.pid)) != 0){
+        release(&p->lock);
+        continue;
+      }
+      s = &buf[n++];
+      memset(s, 0, sizeof(*s));
+      s->pid = d.pid;
+      s->state = UNUSED;
+      s->num_run = d.num_run;
+      s->nmigrate = d.nmigrate;
+      s->creation_time = d.creation_time;
+      s->start_time = d.start_time;
+      s->completion_time = d.completion_time;
+      s->total_run_time = d.total_run_time;
+      s->total_ready_time = d.total_ready_time;
+      s->total_sleep_time = d.total_sleep_time;
+      s->run_ns = d.run_ns;
+      s->ready_ns = d.ready_ns;
+      s->sleep_ns = d.sleep_ns;
+    }
+  }
+  return n;
+}
+
+int
+sys_getprocstats(void)
+{
+  struct procstat *buf;
+  int max;
+
+  if(argint(1, &max) < 0 || max < 0)
+    return -1;
+  if(argptr(0, (char**)&buf, max*sizeof(*buf)) < 0)
+    return -1;
+  return getprocstats(buf, max);
+}
+
+// High-resolution metrics of pid, live or from the
+// completion rings.  Returns -1 if pid is unknown.
+int
+getprocns(int pid, struct perfrec *r)
+{
+  struct proc *p;
+  int found;
+
+  if((found = (p = findproc(pid)) != 0)){
+    perffill(p, r);
+    release(&p->lock);
+  }
+  if(found)
+    return 0;
+  return perflookup(pid, r);
+}
+
+// Store the total context-switch cost of all CPUs in ns
+// at *ns and return the number of switches it covers.
+int
+sys_getswtchcost(void)
+{
+  uint64 *ns, cycles;
+  struct cpu *c;
+  int n;
+
+  if(argptr(0, (char**)&ns, sizeof(*ns)) < 0)
+    return -1;
+  cycles = 0;
+  n = 0;
+  for(c = cpus; c < &cpus[ncpu]; c++){
+    cycles += c->swtchcycles;
+    n += c->nswtch;
+  }
+  *ns = tsc2ns(cycles);
+  return n;
+}
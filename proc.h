@@ -8,6 +8,15 @@ struct cpu {
   int ncli;                    // Depth of pushcli nesting.
   int intena;                  // Were interrupts enabled before pushcli?
   struct proc *proc;           // The process running on this cpu or null
+  struct runq *rq;             // RUNNABLE processes queued on this cpu
+  volatile int idle;           // Halted in scheduler() waiting for work?
+  uint64 swtchstart;           // TSC when a process last entered sched()
+  uint64 swtchcycles;          // Total cycles from sched() to the next process
+  uint nswtch;                 // Number of switches in swtchcycles
+  uint nmigrate;               // Runs of a process that last ran elsewhere
+  uint nsteal;                 // Processes taken from other queues when idle
+  uint npull;                  // Processes moved here by rqbalance()
+  uint lastbalance;            // ticks at the last rqbalance() pass
 };
 
 extern struct cpu cpus[NCPU];
@@ -34,30 +43,34 @@ struct context {
 
 enum procstate { UNUSED, EMBRYO, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
-#define NPROC        64  // maximum number of processes
-
-// Performance metrics structure
-struct PerfData {
-  int pid;
-  int creation_time;
-  int start_time;
-  int completion_time;
-  int total_run_time;
-  int total_ready_time;
-  int valid;  // Flag to indicate if this entry contains valid data
-};
+// Size of the process table, chosen by pinit() at boot.
+extern int nproc;
+#define NPROC nproc
 
 // Per-process state
 struct proc {
+  struct spinlock lock;        // Protects state, chan, killed, the
+                               // metrics, and the swtch handoff
   uint sz;                     // Size of process memory (bytes)
   pde_t* pgdir;                // Page table
   char *kstack;                // Bottom of kernel stack for this process
   enum procstate state;        // Process state
   int pid;                     // Process ID
-  struct proc *parent;          // Parent process
+  struct proc *pidnext;        // Pid index chain (proc.c)
+  struct proc *parent;          // Parent process; ptable.lock
+  struct proc *children;        // First child; ptable.lock
+  struct proc *sibnext;         // Parent's child list (proc.c)
+  struct proc *sibprev;
+  struct proc *freenext;        // Free slot list (proc.c)
   struct trapframe *tf;         // Trap frame for current syscall
   struct context *context;      // swtch() here to run process
   void *chan;                   // If non-zero, sleeping on chan
+  struct proc *sqnext;          // Wait-channel hash chain (proc.c)
+  struct proc *sqprev;
+  uint deadline;                // Tick that ends sleepuntil()
+  struct proc *tqnext;          // Timer wheel chain (proc.c)
+  struct proc *tqprev;
+  int intimerq;                 // On the timer wheel?
   int killed;                   // If non-zero, have been killed
   int runticks;                 // Number of ticks this process has run
   struct file *ofile[NOFILE];   // Open files
@@ -73,12 +86,38 @@ struct proc {
   int total_run_time;             // Total time spent running
   int total_ready_time;           // Total time spent ready
   int total_sleep_time;            // Total time spent sleeping
+  int sleep_start;                 // Time when process last went to sleep
+  uint64 tsc_create;               // TSC timestamps, 0 if not yet reached
+  uint64 tsc_start;
+  uint64 tsc_done;
+  uint64 tsc_run;                  // TSC cycles spent running,
+  uint64 tsc_ready;                // runnable
+  uint64 tsc_sleep;                // and sleeping
+  uint64 tsc_mark;                 // TSC when it became RUNNABLE or SLEEPING
   int num_run;                     // Number of times scheduled
   int priority;                     // Priority level
+
+  // Run queue linkage (runq.c)
+  struct proc *rqnext;              // Next process on the same run queue
+  int slot;                         // Index of this entry in the process table
+  uint rqseq;                       // FIFO arrival order on the run queues
+  int cpu;                          // CPU that last ran or queued this process
+  uint cpumask;                     // CPUs it may run on, one bit each
+  uint rqmask;                      // cpumask when it was queued
+  int lastcpu;                      // CPU that last ran it, -1 if none
+  int nmigrate;                     // Runs on a different CPU than the last
+  uint pass;                        // Stride scheduling virtual time
+  int slice;                        // Ticks used of the current time slice
+  int quantum;                      // Time slice in ticks, 0 for the default
+  uint boost;                       // MLFQ priority boosts seen
+  uint vruntime;                    // CFS weighted virtual runtime
+  int clockcpu;                     // CPU whose queue clock pass or vruntime is on
+  struct proc *rbleft;              // CFS run queue tree links
+  struct proc *rbright;
+  struct proc *rbparent;
+  int rbred;
 };
 
-// Performance metrics storage
-extern struct PerfData perf_data[NPROC];
 
 // // Process management functions
 // struct proc *myproc(void);
@@ -0,0 +1,46 @@
+// Scheduling statistics for one process, as copied out by
+// getprocstats().  Entries for processes that have already
+// been reaped come from the completion history and have
+// state 0 (UNUSED); tickets, priority and runticks are then 0.
+struct procstat {
+  int pid;
+  int state;             // enum procstate
+  char name[16];
+  int tickets;
+  int priority;
+  int runticks;
+  int num_run;           // Number of times scheduled
+  int nmigrate;          // Times it ran on a different CPU than before
+  int creation_time;
+  int start_time;
+  int completion_time;
+  int total_run_time;
+  int total_ready_time;
+  int total_sleep_time;
+  uint64 run_ns;         // Same three totals from the TSC
+  uint64 ready_ns;
+  uint64 sleep_ns;
+};
+
+// Completion record of an exited process, as drained by
+// drainperf().  seq counts records per CPU from 1; a gap
+// means the CPU's ring wrapped before the records were drained.
+struct perfrec {
+  uint seq;
+  int cpu;
+  int pid;
+  int creation_time;
+  int start_time;
+  int completion_time;
+  int total_run_time;
+  int total_ready_time;
+  int total_sleep_time;
+  int num_run;
+  int nmigrate;
+  uint64 creation_ns;    // Times since boot from the TSC
+  uint64 start_ns;
+  uint64 completion_ns;
+  uint64 run_ns;
+  uint64 ready_ns;
+  uint64 sleep_ns;
+};
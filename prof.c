@@ -0,0 +1,123 @@
+// Timer-interrupt sampling profiler.
+//
+// While profiling is on, every timer interrupt on every CPU
+// counts the interrupted eip, and for kernel-mode samples the
+// caller of the interrupted function, in that CPU's hash table.
+// Only that CPU's interrupt handler updates its table, so no
+// lock is taken; getprof() reads the tables as they stand.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "x86.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "prof.h"
+
+#define NPROBE 8  // slots tried before a sample is dropped
+
+struct proftab {
+  struct profent ent[NPROFHASH];
+  uint dropped;
+};
+
+static struct proftab proftab[NCPU];
+int profiling;
+
+static uint
+profhash(uint pc, uint caller, int pid)
+{
+  return ((pc ^ (caller * 31) ^ pid) * 2654435761U) >> 16;
+}
+
+// Count one sample of the trapped context.
+// Called from trap() with interrupts off.
+void
+profsample(struct trapframe *tf)
+{
+  struct proftab *t;
+  struct profent *e;
+  uint pcs[10], caller, h;
+  int i, user, pid;
+
+  t = &proftab[cpuid()];
+  user = (tf->cs & 3) == DPL_USER;
+  caller = 0;
+  pid = 0;
+  if(user)
+    pid = myproc()->pid;
+  else if(tf->ebp >= KERNBASE && tf->ebp < (uint)P2V(PHYSTOP)){
+    getcallerpcs((uint*)tf->ebp + 2, pcs);
+    caller = pcs[0];
+  }
+
+  h = profhash(tf->eip, caller, pid);
+  for(i = 0; i < NPROBE; i++){
+    e = &t->ent[(h + i) % NPROFHASH];
+    if(e->count == 0){
+      e->pc = tf->eip;
+      e->caller = caller;
+      e->user = user;
+      e->pid = pid;
+      e->cpu = t - proftab;
+      __sync_synchronize();
+      e->count = 1;
+      return;
+    }
+    if(e->pc == tf->eip && e->caller == caller && e->pid == pid &&
+       e->user == user){
+      e->count++;
+      return;
+    }
+  }
+  t->dropped++;
+}
+
+// Clear all tables and start (on != 0) or stop sampling.
+int
+sys_profctl(void)
+{
+  int on;
+
+  if(argint(0, &on) < 0)
+    return -1;
+  profiling = 0;
+  if(on){
+    // No CPU samples while profiling is 0, except one that
+    // tested it just before; that sample may survive.
+    memset(proftab, 0, sizeof(proftab));
+    __sync_synchronize();
+    profiling = 1;
+  }
+  return 0;
+}
+
+// Copy up to max histogram entries of all CPUs to buf.
+int
+sys_getprof(void)
+{
+  struct profent *buf;
+  struct proftab *t;
+  struct profent *e;
+  int max, n;
+
+  if(argint(1, &max) < 0 || max < 0)
+    return -1;
+  if(argptr(0, (char**)&buf, max*sizeof(*buf)) < 0)
+    return -1;
+  n = 0;
+  for(t = proftab; t < &proftab[ncpu]; t++){
+    if(t->dropped && n < max){
+      memset(&buf[n], 0, sizeof(buf[n]));
+      buf[n].cpu = t - proftab;
+      buf[n].count = t->dropped;
+      n++;
+    }
+    for(e = t->ent; e < &t->ent[NPROFHASH] && n < max; e++)
+      if(e->count)
+        buf[n++] = *e;
+  }
+  return n;
+}
@@ -0,0 +1,11 @@
+// Sampling profiler histogram entries, as returned by getprof().
+// An entry with pc 0 counts samples dropped because a CPU's
+// table was full.
+struct profent {
+  uint pc;       // eip when the timer interrupt hit
+  uint caller;   // kernel samples: return address of pc's function
+  uint count;    // samples
+  ushort cpu;
+  ushort user;   // 1 if pc is a user address, of process pid
+  int pid;       // user samples only
+};
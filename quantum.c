@@ -0,0 +1,62 @@
+// Show or change scheduler time slices, in ticks.
+//
+//   quantum                  print the policy default
+//   quantum -d ticks         change the default
+//   quantum -p pid [ticks]   print or change pid's slice;
+//                            0 returns it to the default
+//   quantum ticks cmd args   run cmd, and everything it forks,
+//                            with that slice
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+static void
+usage(void)
+{
+  printf(2, "usage: quantum [-d ticks]\n"
+            "       quantum -p pid [ticks]\n"
+            "       quantum ticks cmd [args]\n");
+  exit();
+}
+
+int
+main(int argc, char *argv[])
+{
+  int pid, ticks;
+
+  if(argc == 1){
+    printf(1, "default %d ticks\n", getquantum(0));
+    exit();
+  }
+  if(strcmp(argv[1], "-d") == 0){
+    if(argc != 3)
+      usage();
+    if(setquantum(0, atoi(argv[2])) < 0)
+      printf(2, "quantum: bad slice %s\n", argv[2]);
+    exit();
+  }
+  if(strcmp(argv[1], "-p") == 0){
+    if(argc < 3)
+      usage();
+    pid = atoi(argv[2]);
+    if(argc == 3){
+      if((ticks = getquantum(pid)) < 0)
+        printf(2, "quantum: no process %d\n", pid);
+      else
+        printf(1, "pid %d %d ticks\n", pid, ticks);
+    } else if(setquantum(pid, atoi(argv[3])) < 0)
+      printf(2, "quantum: cannot set pid %d to %s\n", pid, argv[3]);
+    exit();
+  }
+  if(argc < 3)
+    usage();
+
+  if(setquantum(getpid(), atoi(argv[1])) < 0){
+    printf(2, "quantum: bad slice %s\n", argv[1]);
+    exit();
+  }
+  exec(argv[2], argv + 2);
+  printf(2, "quantum: exec %s failed\n", argv[2]);
+  exit();
+}
@@ -36,5 +36,8 @@ mkdir -p results
 run_scheduler_test "default"
 run_scheduler_test "FIFO"
 run_scheduler_test "LOTTERY"
+run_scheduler_test "STRIDE"
+run_scheduler_test "MLFQ"
+run_scheduler_test "CFS"
 
 echo "All tests completed!" 
\ No newline at end of file
@@ -19,4 +19,25 @@ echo "Testing Lottery scheduler..."
 make clean
 make SCHEDULER=LOTTERY qemu-nox << EOF
 scheduler_test
-EOF 
\ No newline at end of file
+EOF
+
+# 测试步幅调度器
+echo "Testing Stride scheduler..."
+make clean
+make SCHEDULER=STRIDE qemu-nox << EOF
+scheduler_test
+EOF
+
+# 测试多级反馈队列调度器
+echo "Testing MLFQ scheduler..."
+make clean
+make SCHEDULER=MLFQ qemu-nox << EOF
+scheduler_test
+EOF
+
+# 测试完全公平调度器
+echo "Testing CFS scheduler..."
+make clean
+make SCHEDULER=CFS qemu-nox << EOF
+scheduler_test
+EOF
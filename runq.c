@@ -0,0 +1,994 @@
+// Per-CPU run queues.
+//
+// Each CPU owns a queue of RUNNABLE processes with its own lock.
+// A process sits on exactly one queue while it is RUNNABLE and
+// on none otherwise.  scheduler() takes the next process from
+// its own CPU's queue; a CPU whose queue is empty steals from
+// the busiest other CPU instead of scanning the process table.
+//
+// The order in which a queue hands out processes depends on the
+// policy chosen at compile time with SCHEDULER:
+//   DEFAULT  round robin.
+//   FIFO     arrival order across all CPUs; each process runs
+//            until it blocks or exits.
+//   LOTTERY  random draw weighted by p->tickets, found in
+//            O(log NPROC) with a Fenwick tree of queued tickets.
+//   STRIDE   smallest pass value first, from a min-heap; each
+//            dispatch advances p->pass by STRIDE1/p->tickets.
+//   MLFQ     NMLFQ round-robin levels by p->priority; a process
+//            that uses up its level's quantum, which doubles at
+//            each level, drops a level, and every MLFQBOOST
+//            ticks everything returns to level 0.
+//   CFS      smallest weighted virtual runtime first, from a
+//            red-black tree; weight is p->tickets.
+//
+// Callers of rqadd() hold p->lock, which protects p->state;
+// rq->lock protects the queue itself.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "x86.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "traps.h"
+#include "random.h"
+#include "cpustat.h"
+
+struct runq {
+  struct spinlock lock;
+  volatile int n;      // Number of queued processes
+  volatile int nfor[NCPU];  // How many of them may run on each CPU
+#if defined(SCHEDULER_LOTTERY)
+  int tickets;                // Sum of p->tickets of queued processes
+  int *tree;                  // Fenwick tree of tickets by p->slot, [NPROC+1]
+  struct proc **slot;         // Queued process in each slot, or 0, [NPROC]
+#elif defined(SCHEDULER_STRIDE)
+  uint pass;                  // Pass of the last process dispatched
+  struct proc **heap;         // Min-heap of queued processes by pass, [NPROC]
+#elif defined(SCHEDULER_MLFQ)
+  struct proc *head[NMLFQ];   // Next process to run at each level
+  struct proc *tail[NMLFQ];
+#elif defined(SCHEDULER_CFS)
+  struct proc *root;          // Red-black tree of queued processes by vruntime
+  struct proc *leftmost;      // Queued process with the smallest vruntime
+  uint minvruntime;           // Never decreases; floor for joining processes
+#else
+  struct proc *head;   // Next process to run
+  struct proc *tail;   // Most recently queued process
+#endif
+};
+
+static struct runq runqs[NCPU];
+
+#ifdef SCHEDULER_FIFO
+static uint arrivals;   // Stamps p->rqseq with global arrival order
+#endif
+
+#ifdef SCHEDULER_LOTTERY
+// Add delta to the tickets counted for slot i.
+static void
+fenadd(int *tree, int i, int delta)
+{
+  for(i++; i <= NPROC; i += i & -i)
+    tree[i] += delta;
+}
+
+// Return the slot holding the winning ticket: the smallest
+// slot i whose prefix sum of tickets exceeds winner.
+static int
+fenfind(int *tree, int winner)
+{
+  int i, step;
+
+  for(step = 1; step*2 <= NPROC; step *= 2)
+    ;
+  for(i = 0; step > 0; step /= 2){
+    if(i+step <= NPROC && tree[i+step] <= winner){
+      i += step;
+      winner -= tree[i];
+    }
+  }
+  return i;
+}
+#endif
+
+#if defined(SCHEDULER_STRIDE) || defined(SCHEDULER_CFS)
+// Does virtual time a come before b?  Compares so that the
+// order survives the counters wrapping around.
+static int
+before(uint a, uint b)
+{
+  return (int)(a - b) < 0;
+}
+#endif
+
+#ifdef SCHEDULER_STRIDE
+#define STRIDE1 (1<<16)   // Stride of a process holding one ticket
+
+// Restore the heap property by moving heap[i] up toward the root.
+static void
+siftup(struct proc **heap, int i)
+{
+  struct proc *p;
+
+  p = heap[i];
+  while(i > 0 && before(p->pass, heap[(i-1)/2]->pass)){
+    heap[i] = heap[(i-1)/2];
+    i = (i-1)/2;
+  }
+  heap[i] = p;
+}
+
+// Restore the heap property by moving heap[i] down toward the leaves.
+static void
+siftdown(struct proc **heap, int n, int i)
+{
+  struct proc *p;
+  int c;
+
+  p = heap[i];
+  while((c = 2*i+1) < n){
+    if(c+1 < n && before(heap[c+1]->pass, heap[c]->pass))
+      c++;
+    if(!before(heap[c]->pass, p->pass))
+      break;
+    heap[i] = heap[c];
+    i = c;
+  }
+  heap[i] = p;
+}
+#endif
+
+#ifdef SCHEDULER_CFS
+// A process with DEFAULT_TICKETS tickets gains CFSSCALE of
+// virtual runtime per tick; others gain in inverse proportion
+// to their tickets.
+#define CFSSCALE 1024
+
+// A process joining a queue starts no more than this far
+// behind the queue's minvruntime: one minimum slice of credit.
+#define CFSCREDIT (CFSMINSLICE * CFSSCALE)
+
+// Does a run before b?  Ties go to the lower slot.
+static int
+vless(struct proc *a, struct proc *b)
+{
+  if(a->vruntime != b->vruntime)
+    return before(a->vruntime, b->vruntime);
+  return a->slot < b->slot;
+}
+
+static void
+rotleft(struct runq *rq, struct proc *x)
+{
+  struct proc *y;
+
+  y = x->rbright;
+  x->rbright = y->rbleft;
+  if(y->rbleft)
+    y->rbleft->rbparent = x;
+  y->rbparent = x->rbparent;
+  if(x->rbparent == 0)
+    rq->root = y;
+  else if(x == x->rbparent->rbleft)
+    x->rbparent->rbleft = y;
+  else
+    x->rbparent->rbright = y;
+  y->rbleft = x;
+  x->rbparent = y;
+}
+
+static void
+rotright(struct runq *rq, struct proc *x)
+{
+  struct proc *y;
+
+  y = x->rbleft;
+  x->rbleft = y->rbright;
+  if(y->rbright)
+    y->rbright->rbparent = x;
+  y->rbparent = x->rbparent;
+  if(x->rbparent == 0)
+    rq->root = y;
+  else if(x == x->rbparent->rbright)
+    x->rbparent->rbright = y;
+  else
+    x->rbparent->rbleft = y;
+  y->rbright = x;
+  x->rbparent = y;
+}
+
+#define RED(x) ((x) != 0 && (x)->rbred)
+
+// Insert z into rq's tree.
+static void
+rbinsert(struct runq *rq, struct proc *z)
+{
+  struct proc *x, *y, *g, *u;
+
+  y = 0;
+  for(x = rq->root; x; x = vless(z, x) ? x->rbleft : x->rbright)
+    y = x;
+  z->rbparent = y;
+  z->rbleft = z->rbright = 0;
+  z->rbred = 1;
+  if(y == 0)
+    rq->root = z;
+  else if(vless(z, y))
+    y->rbleft = z;
+  else
+    y->rbright = z;
+  if(rq->leftmost == 0 || vless(z, rq->leftmost))
+    rq->leftmost = z;
+
+  while(RED(z->rbparent)){
+    y = z->rbparent;
+    g = y->rbparent;
+    if(y == g->rbleft){
+      u = g->rbright;
+      if(RED(u)){
+        y->rbred = u->rbred = 0;
+        g->rbred = 1;
+        z = g;
+        continue;
+      }
+      if(z == y->rbright){
+        z = y;
+        rotleft(rq, z);
+        y = z->rbparent;
+      }
+      y->rbred = 0;
+      g->rbred = 1;
+      rotright(rq, g);
+    } else {
+      u = g->rbleft;
+      if(RED(u)){
+        y->rbred = u->rbred = 0;
+        g->rbred = 1;
+        z = g;
+        continue;
+      }
+      if(z == y->rbleft){
+        z = y;
+        rotright(rq, z);
+        y = z->rbparent;
+      }
+      y->rbred = 0;
+      g->rbred = 1;
+      rotleft(rq, g);
+    }
+  }
+  rq->root->rbred = 0;
+}
+
+// Remove z from rq's tree.
+static void
+rberase(struct runq *rq, struct proc *z)
+{
+  struct proc *x, *xp, *y, *w;
+  int red;
+
+  if(z == rq->leftmost){
+    if(z->rbright)
+      for(rq->leftmost = z->rbright; rq->leftmost->rbleft; )
+        rq->leftmost = rq->leftmost->rbleft;
+    else
+      rq->leftmost = z->rbparent;
+  }
+
+  // Splice out y, which is z or, if z has two children,
+  // z's successor; x takes y's place under xp.
+  y = z;
+  if(z->rbleft && z->rbright)
+    for(y = z->rbright; y->rbleft; y = y->rbleft)
+      ;
+  x = y->rbleft ? y->rbleft : y->rbright;
+  xp = y->rbparent;
+  if(x)
+    x->rbparent = xp;
+  if(xp == 0)
+    rq->root = x;
+  else if(y == xp->rbleft)
+    xp->rbleft = x;
+  else
+    xp->rbright = x;
+  red = y->rbred;
+
+  // Put y where z was.
+  if(y != z){
+    if(xp == z)
+      xp = y;
+    y->rbleft = z->rbleft;
+    y->rbright = z->rbright;
+    y->rbparent = z->rbparent;
+    y->rbred = z->rbred;
+    if(y->rbleft)
+      y->rbleft->rbparent = y;
+    if(y->rbright)
+      y->rbright->rbparent = y;
+    if(y->rbparent == 0)
+      rq->root = y;
+    else if(y->rbparent->rbleft == z)
+      y->rbparent->rbleft = y;
+    else
+      y->rbparent->rbright = y;
+  }
+  if(red)
+    return;
+
+  while(x != rq->root && !RED(x)){
+    if(x == xp->rbleft){
+      w = xp->rbright;
+      if(RED(w)){
+        w->rbred = 0;
+        xp->rbred = 1;
+        rotleft(rq, xp);
+        w = xp->rbright;
+      }
+      if(!RED(w->rbleft) && !RED(w->rbright)){
+        w->rbred = 1;
+        x = xp;
+        xp = x->rbparent;
+        continue;
+      }
+      if(!RED(w->rbright)){
+        w->rbleft->rbred = 0;
+        w->rbred = 1;
+        rotright(rq, w);
+        w = xp->rbright;
+      }
+      w->rbred = xp->rbred;
+      xp->rbred = 0;
+      w->rbright->rbred = 0;
+      rotleft(rq, xp);
+    } else {
+      w = xp->rbleft;
+      if(RED(w)){
+        w->rbred = 0;
+        xp->rbred = 1;
+        rotright(rq, xp);
+        w = xp->rbleft;
+      }
+      if(!RED(w->rbleft) && !RED(w->rbright)){
+        w->rbred = 1;
+        x = xp;
+        xp = x->rbparent;
+        continue;
+      }
+      if(!RED(w->rbleft)){
+        w->rbright->rbred = 0;
+        w->rbred = 1;
+        rotleft(rq, w);
+        w = xp->rbleft;
+      }
+      w->rbred = xp->rbred;
+      xp->rbred = 0;
+      w->rbleft->rbred = 0;
+      rotright(rq, xp);
+    }
+    x = rq->root;
+  }
+  if(x)
+    x->rbred = 0;
+}
+#endif
+
+// Ticks a process runs before the timer preempts it, unless
+// it has set its own with setquantum().  Under MLFQ this is
+// the slice at level 0; under CFS, the minimum slice.
+#ifdef SCHEDULER_CFS
+int defquantum = CFSMINSLICE;
+#else
+int defquantum = 1;
+#endif
+
+#ifndef SCHEDULER_FIFO
+static int
+quantum(struct proc *p)
+{
+  return p->quantum ? p->quantum : defquantum;
+}
+#endif
+
+#ifdef SCHEDULER_MLFQ
+// Number of priority boosts so far.  A process that has not
+// seen the latest boost is moved back to level 0 the next
+// time the scheduler looks at it.
+static volatile uint boosts;
+
+static void
+syncboost(struct proc *p)
+{
+  if(p->boost != boosts){
+    p->boost = boosts;
+    p->priority = 0;
+    p->slice = 0;
+  }
+}
+#endif
+
+void
+rqinit(void)
+{
+  int i;
+
+  for(i = 0; i < NCPU; i++){
+    initlock(&runqs[i].lock, "runq");
+    cpus[i].rq = &runqs[i];
+#if defined(SCHEDULER_LOTTERY)
+    runqs[i].tree = bootalloc((NPROC+1) * sizeof(int));
+    runqs[i].slot = bootalloc(NPROC * sizeof(struct proc*));
+#elif defined(SCHEDULER_STRIDE)
+    runqs[i].heap = bootalloc(NPROC * sizeof(struct proc*));
+#endif
+  }
+}
+
+// Work was just queued on t.  If t is halted in idle(),
+// wake it; if t is busy, wake some idle CPU to steal it.
+// release() has already ordered the queue update before
+// these reads of idle.
+static void
+kick(struct cpu *t)
+{
+  struct cpu *c, *self;
+
+  self = mycpu();
+  if(t->idle){
+    if(t != self)
+      lapicipi(t->apicid, T_IRQ0 + IRQ_WAKE);
+    return;
+  }
+  for(c = cpus; c < cpus+ncpu; c++){
+    if(c != self && c->idle){
+      lapicipi(c->apicid, T_IRQ0 + IRQ_WAKE);
+      return;
+    }
+  }
+}
+
+// May p run on c?
+static int
+canrun(struct proc *p, struct cpu *c)
+{
+  return (p->cpumask & (1 << (c - cpus))) != 0;
+}
+
+// Add delta to the count in rq->nfor of each CPU in mask.
+static void
+countfor(struct runq *rq, uint mask, int delta)
+{
+  int i;
+
+  for(i = 0; i < ncpu; i++)
+    if(mask & (1 << i))
+      rq->nfor[i] += delta;
+}
+
+// May queued p be handed to thief?  Any process may be
+// taken by its own CPU (thief 0); the scheduler moves it
+// on if its mask has since changed.
+static int
+eligible(struct proc *p, struct cpu *thief)
+{
+  return thief == 0 || (p->rqmask & (1 << (thief - cpus))) != 0;
+}
+
+// The CPU in p's affinity mask with the shortest queue.
+static int
+allowedcpu(struct proc *p)
+{
+  struct cpu *c, *best;
+
+  best = 0;
+  for(c = cpus; c < cpus+ncpu; c++)
+    if(canrun(p, c) && (best == 0 || c->rq->n < best->rq->n))
+      best = c;
+  return best ? best - cpus : p->cpu;
+}
+
+#if defined(SCHEDULER_STRIDE) || defined(SCHEDULER_CFS)
+// Each queue's pass or minvruntime is its own clock, and
+// p->pass or p->vruntime counts on the clock of p->clockcpu's
+// queue.  Move p to c's clock, keeping how far p is ahead of
+// or behind the clock it leaves, as when p changes queues.
+// The old queue's clock is read without its lock; it only
+// moves forward, so a stale value is at most the time since
+// behind.
+static void
+rebase(struct proc *p, int c)
+{
+  if(p->clockcpu == c)
+    return;
+#ifdef SCHEDULER_STRIDE
+  p->pass = p->pass - runqs[p->clockcpu].pass + runqs[c].pass;
+#else
+  p->vruntime = p->vruntime - runqs[p->clockcpu].minvruntime +
+                runqs[c].minvruntime;
+#endif
+  p->clockcpu = c;
+}
+#endif
+
+// Queue p on the CPU that last ran it, or if p may no
+// longer run there, on the least busy CPU it may run on.
+// Caller must hold p->lock and have made p RUNNABLE.
+void
+rqadd(struct proc *p)
+{
+  struct runq *rq;
+
+  if(!canrun(p, &cpus[p->cpu]))
+    p->cpu = allowedcpu(p);
+  rq = cpus[p->cpu].rq;
+  acquire(&rq->lock);
+#if defined(SCHEDULER_LOTTERY)
+  rq->slot[p->slot] = p;
+  fenadd(rq->tree, p->slot, p->tickets);
+  rq->tickets += p->tickets;
+#elif defined(SCHEDULER_STRIDE)
+  // A process moving here from another CPU keeps its place
+  // relative to the queue's pass.  One returning from sleep
+  // joins no earlier than the current pass, so it can't cash
+  // in the time it was away.
+  rebase(p, p->cpu);
+  if(before(p->pass, rq->pass))
+    p->pass = rq->pass;
+  rq->heap[rq->n] = p;
+  siftup(rq->heap, rq->n);
+#elif defined(SCHEDULER_MLFQ)
+  syncboost(p);
+  p->rqnext = 0;
+  if(rq->tail[p->priority])
+    rq->tail[p->priority]->rqnext = p;
+  else
+    rq->head[p->priority] = p;
+  rq->tail[p->priority] = p;
+#elif defined(SCHEDULER_CFS)
+  // A process moving here from another CPU keeps its place
+  // relative to the clock, and one returning from sleep keeps
+  // at most CFSCREDIT of credit for the time it was away.
+  rebase(p, p->cpu);
+  if(before(p->vruntime, rq->minvruntime - CFSCREDIT))
+    p->vruntime = rq->minvruntime - CFSCREDIT;
+  rbinsert(rq, p);
+#else
+#ifdef SCHEDULER_FIFO
+  p->rqseq = __sync_fetch_and_add(&arrivals, 1);
+#endif
+  p->rqnext = 0;
+  if(rq->tail)
+    rq->tail->rqnext = p;
+  else
+    rq->head = p;
+  rq->tail = p;
+#endif
+  rq->n++;
+  p->rqmask = p->cpumask;
+  countfor(rq, p->rqmask, 1);
+  release(&rq->lock);
+  kick(&cpus[p->cpu]);
+}
+
+#ifdef SCHEDULER_CFS
+// The queued process after p in vruntime order, or 0.
+static struct proc*
+rbnext(struct proc *p)
+{
+  if(p->rbright){
+    for(p = p->rbright; p->rbleft; p = p->rbleft)
+      ;
+    return p;
+  }
+  while(p->rbparent && p == p->rbparent->rbright)
+    p = p->rbparent;
+  return p->rbparent;
+}
+#endif
+
+#if !defined(SCHEDULER_LOTTERY) && !defined(SCHEDULER_STRIDE) && \
+    !defined(SCHEDULER_CFS)
+// Remove p from the list at *head, whose last entry is *tail.
+// Returns 0 if p isn't on it.
+static int
+listdel(struct proc **head, struct proc **tail, struct proc *p)
+{
+  struct proc **pp, *prev;
+
+  prev = 0;
+  for(pp = head; *pp != p; pp = &(*pp)->rqnext){
+    if(*pp == 0)
+      return 0;
+    prev = *pp;
+  }
+  *pp = p->rqnext;
+  if(*tail == p)
+    *tail = prev;
+  p->rqnext = 0;
+  return 1;
+}
+#endif
+
+// The process rq should hand out next, or 0 if none.  If
+// thief is set, the first in rq's order that may run there,
+// which can be behind some that may not.  Caller must hold
+// rq->lock.
+static struct proc*
+rqnext(struct runq *rq, struct cpu *thief)
+{
+  struct proc *p;
+#if defined(SCHEDULER_LOTTERY) || defined(SCHEDULER_STRIDE) || \
+    defined(SCHEDULER_MLFQ)
+  int i;
+#endif
+#if defined(SCHEDULER_LOTTERY)
+  int s;
+#elif defined(SCHEDULER_STRIDE)
+  struct proc *best;
+#endif
+
+  if(rq->n == 0 || (thief && rq->nfor[thief - cpus] == 0))
+    return 0;
+#if defined(SCHEDULER_LOTTERY)
+  // The winner of the draw, or failing that the next slot
+  // after it that thief may take.
+  s = fenfind(rq->tree, get_random(0, rq->tickets));
+  for(i = 0; i < NPROC; i++){
+    p = rq->slot[(s + i) % NPROC];
+    if(p && eligible(p, thief))
+      return p;
+  }
+#elif defined(SCHEDULER_STRIDE)
+  if(eligible(rq->heap[0], thief))
+    return rq->heap[0];
+  best = 0;
+  for(i = 1; i < rq->n; i++){
+    p = rq->heap[i];
+    if(eligible(p, thief) && (best == 0 || before(p->pass, best->pass)))
+      best = p;
+  }
+  return best;
+#elif defined(SCHEDULER_MLFQ)
+  for(i = 0; i < NMLFQ; i++)
+    for(p = rq->head[i]; p; p = p->rqnext)
+      if(eligible(p, thief))
+        return p;
+#elif defined(SCHEDULER_CFS)
+  for(p = rq->leftmost; p; p = rbnext(p))
+    if(eligible(p, thief))
+      return p;
+#else
+  for(p = rq->head; p; p = p->rqnext)
+    if(eligible(p, thief))
+      return p;
+#endif
+  return 0;
+}
+
+// Remove queued p from rq.  Caller must hold rq->lock.
+static void
+rqdel(struct runq *rq, struct proc *p)
+{
+#if defined(SCHEDULER_LOTTERY)
+  rq->slot[p->slot] = 0;
+  fenadd(rq->tree, p->slot, -p->tickets);
+  rq->tickets -= p->tickets;
+#elif defined(SCHEDULER_STRIDE)
+  int i;
+
+  for(i = 0; rq->heap[i] != p; i++)
+    ;
+  rq->heap[i] = rq->heap[rq->n-1];
+  if(i < rq->n-1){
+    siftdown(rq->heap, rq->n-1, i);
+    siftup(rq->heap, i);
+  }
+#elif defined(SCHEDULER_MLFQ)
+  int i;
+
+  // p is usually a head.  Otherwise search every level:
+  // rqclock() may have moved p to level 0 since it was queued.
+  for(i = 0; i < NMLFQ && rq->head[i] != p; i++)
+    ;
+  if(i < NMLFQ)
+    listdel(&rq->head[i], &rq->tail[i], p);
+  else
+    for(i = 0; i < NMLFQ; i++)
+      if(listdel(&rq->head[i], &rq->tail[i], p))
+        break;
+#elif defined(SCHEDULER_CFS)
+  rberase(rq, p);
+#else
+  listdel(&rq->head, &rq->tail, p);
+#endif
+  rq->n--;
+  countfor(rq, p->rqmask, -1);
+}
+
+// Remove and return the next process from rq, or 0 if there
+// is none.  If thief is set, the process is being stolen for
+// that CPU and is the next one that may run there; the
+// queue's own virtual time then stays where it is, since rq
+// is not dispatching.
+static struct proc*
+rqtake(struct runq *rq, struct cpu *thief)
+{
+  struct proc *p;
+
+  acquire(&rq->lock);
+  if((p = rqnext(rq, thief)) == 0){
+    release(&rq->lock);
+    return 0;
+  }
+  rqdel(rq, p);
+#if defined(SCHEDULER_STRIDE)
+  if(thief == 0)
+    rq->pass = p->pass;
+  else
+    rebase(p, thief - cpus);
+  // Charge the first tick up front, so that a process can't
+  // run free by blocking just before each timer interrupt;
+  // rqtick() charges the rest of its slice.
+  p->pass += STRIDE1 / p->tickets;
+#elif defined(SCHEDULER_CFS)
+  if(thief == 0 && before(rq->minvruntime, p->vruntime))
+    rq->minvruntime = p->vruntime;
+  if(thief)
+    rebase(p, thief - cpus);
+#endif
+#ifndef SCHEDULER_MLFQ
+  p->slice = 0;
+#endif
+  release(&rq->lock);
+  return p;
+}
+
+#ifndef SCHEDULER_FIFO
+// Remove and return a process from rq that may run on c, or
+// 0 if there is none, for the balancer to queue on c.  It is
+// moved, not dispatched, so unlike rqtake() this charges
+// neither the process nor rq's virtual time for a run.
+static struct proc*
+rqmigrate(struct runq *rq, struct cpu *c)
+{
+  struct proc *p;
+
+  acquire(&rq->lock);
+  if((p = rqnext(rq, c)) != 0)
+    rqdel(rq, p);
+  release(&rq->lock);
+  return p;
+}
+#endif
+
+// Return the CPU other than c with the most queued processes
+// that may run on c, or 0 if none has any, so that rqtake()
+// finds one there and CPUs with nothing they may run halt
+// instead of polling.  Reads the counts without locks, so
+// the answer is only a hint.
+static struct cpu*
+busiest(struct cpu *c)
+{
+  struct cpu *b, *best;
+  int n, most;
+
+  best = 0;
+  most = 0;
+  for(b = cpus; b < cpus+ncpu; b++){
+    n = b->rq->nfor[c - cpus];
+    if(b == c || n <= 0)
+      continue;
+    if(best == 0 || n > most){
+      best = b;
+      most = n;
+    }
+  }
+  return best;
+}
+
+#ifdef SCHEDULER_FIFO
+// Return the CPU whose queue holds the earliest arrival, of
+// the queues with something c may run, or 0 if there is none.
+// Each queue is in arrival order, so only the heads need
+// comparing.  Lock-free, so only a hint.
+static struct cpu*
+oldest(struct cpu *c)
+{
+  struct cpu *b, *best;
+  struct proc *h;
+  uint seq;
+
+  best = 0;
+  seq = 0;
+  for(b = cpus; b < cpus+ncpu; b++){
+    if((h = b->rq->head) == 0 || (b != c && b->rq->nfor[c - cpus] == 0))
+      continue;
+    if(best == 0 || (int)(h->rqseq - seq) < 0){
+      best = b;
+      seq = h->rqseq;
+    }
+  }
+  return best;
+}
+#endif
+
+// Is there anything for c to run?  Lock-free, so that idle
+// CPUs can poll without touching any lock.
+int
+rqready(struct cpu *c)
+{
+  return c->rq->n > 0 || busiest(c) != 0;
+}
+
+// Remove and return the process c should run next:
+// from c's own queue if it has one, else stolen from the
+// busiest other CPU, passing over any barred from c.  Returns 0
+// if there is none.  The caller locks the process once it
+// has it, and requeues it if its affinity changed while it
+// sat on c's own queue.
+struct proc*
+rqpick(struct cpu *c)
+{
+  struct proc *p;
+  struct cpu *victim;
+
+#ifdef SCHEDULER_FIFO
+  // Serve the earliest arrival on any CPU, not just this one.
+  if((victim = oldest(c)) != 0 &&
+     (p = rqtake(victim->rq, victim == c ? 0 : c)) != 0){
+    if(victim != c)
+      c->nsteal++;
+    return p;
+  }
+#endif
+  if((p = rqtake(c->rq, 0)) != 0)
+    return p;
+  if((victim = busiest(c)) == 0)
+    return 0;
+  if((p = rqtake(victim->rq, c)) != 0)
+    c->nsteal++;
+  return p;
+}
+
+#ifndef SCHEDULER_FIFO
+// Processes queued on or running on c.
+static int
+load(struct cpu *c)
+{
+  return c->rq->n + (c->proc != 0);
+}
+#endif
+
+// Called on every CPU's timer tick, with interrupts off.
+// Every BALANCETICKS ticks, pull queued processes from the
+// busiest CPU until the two loads differ by at most one.
+// A move then never reverses the imbalance it corrects, so
+// processes don't bounce back and forth; halted CPUs steal
+// for themselves when woken and need no balancing.
+void
+rqbalance(void)
+{
+#ifdef SCHEDULER_FIFO
+  // oldest() already serves the global arrival order, and
+  // moving a process would send it to the back.
+  return;
+#else
+  struct cpu *c, *victim;
+  struct proc *p;
+  int n;
+
+  c = mycpu();
+  if(ticks - c->lastbalance < BALANCETICKS)
+    return;
+  c->lastbalance = ticks;
+  if((victim = busiest(c)) == 0)
+    return;
+  for(n = (load(victim) - load(c)) / 2; n > 0; n--){
+    if((p = rqmigrate(victim->rq, c)) == 0)
+      break;
+    acquire(&p->lock);
+    p->cpu = c - cpus;
+    rqadd(p);
+    release(&p->lock);
+    c->npull++;
+  }
+#endif
+}
+
+// Copy the scheduling counters of up to max CPUs to buf.
+// Returns the number of entries.
+int
+sys_cpustat(void)
+{
+  struct cpustat *buf;
+  struct cpu *c;
+  int max, n;
+
+  if(argint(1, &max) < 0 || max < 0)
+    return -1;
+  if(argptr(0, (char**)&buf, max*sizeof(*buf)) < 0)
+    return -1;
+  n = 0;
+  for(c = cpus; c < cpus+ncpu && n < max; c++, n++){
+    buf[n].cpu = c - cpus;
+    buf[n].queued = c->rq->n;
+    buf[n].nswtch = c->nswtch;
+    buf[n].nmigrate = c->nmigrate;
+    buf[n].nsteal = c->nsteal;
+    buf[n].npull = c->npull;
+  }
+  return n;
+}
+
+// Charge the running process p for a timer tick on its CPU.
+// Returns nonzero if p has used up its time slice and should
+// yield.
+int
+rqtick(struct proc *p)
+{
+#if defined(SCHEDULER_FIFO)
+  // FIFO runs each process until it blocks or exits.
+  return 0;
+#elif defined(SCHEDULER_MLFQ)
+  syncboost(p);
+  if(++p->slice < quantum(p) << p->priority)
+    return 0;
+  if(p->priority < NMLFQ-1)
+    p->priority++;
+  p->slice = 0;
+  return 1;
+#elif defined(SCHEDULER_CFS)
+  struct runq *rq;
+  int preempt;
+
+  p->vruntime += CFSSCALE * DEFAULT_TICKETS / p->tickets;
+  if(++p->slice < quantum(p))
+    return 0;
+  // Past the minimum slice, run on until some queued
+  // process has fallen behind p.
+  rq = cpus[p->cpu].rq;
+  acquire(&rq->lock);
+  preempt = rq->leftmost && before(rq->leftmost->vruntime, p->vruntime);
+  release(&rq->lock);
+  return preempt;
+#else
+#ifdef SCHEDULER_STRIDE
+  if(p->slice > 0)
+    p->pass += STRIDE1 / p->tickets;
+#endif
+  return ++p->slice >= quantum(p);
+#endif
+}
+
+// Called by CPU 0 once per timer tick, after ticks has advanced.
+void
+rqclock(void)
+{
+#ifdef SCHEDULER_MLFQ
+  struct runq *rq;
+  int i;
+
+  if(ticks % MLFQBOOST != 0)
+    return;
+  // Move every queued process to level 0.  Each process resets
+  // its own priority when syncboost() sees the new boost count.
+  boosts++;
+  for(rq = runqs; rq < &runqs[ncpu]; rq++){
+    acquire(&rq->lock);
+    for(i = 1; i < NMLFQ; i++){
+      if(rq->head[i] == 0)
+        continue;
+      if(rq->tail[0])
+        rq->tail[0]->rqnext = rq->head[i];
+      else
+        rq->head[0] = rq->head[i];
+      rq->tail[0] = rq->tail[i];
+      rq->head[i] = rq->tail[i] = 0;
+    }
+    release(&rq->lock);
+  }
+#endif
+}
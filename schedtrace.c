@@ -0,0 +1,136 @@
+// Dump the kernel's scheduler trace.
+//
+//   schedtrace            print the events buffered so far
+//   schedtrace cmd args   run cmd, then print the events of the run
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "trace.h"
+
+#define NEV 512
+#define NELEM(x) (sizeof(x)/sizeof((x)[0]))
+
+static struct schedev ev[NEV];
+static uint lastseq[16];  // per CPU, to report lost events
+
+static char *states[] = { "unused", "embryo", "sleep", "yield", "run", "exit" };
+
+// printf has no 64-bit conversion, and the user library has
+// no 64-bit division, so divide by 10 in 16-bit pieces.
+static void
+printu64(uint64 v)
+{
+  char buf[21];
+  uint hi, lo, r, t, q1, q0;
+  int i;
+
+  hi = v >> 32;
+  lo = v;
+  i = sizeof(buf) - 1;
+  buf[i] = 0;
+  do {
+    r = hi % 10;
+    hi /= 10;
+    t = (r << 16) | (lo >> 16);
+    q1 = t / 10;
+    r = t % 10;
+    t = (r << 16) | (lo & 0xffff);
+    q0 = t / 10;
+    r = t % 10;
+    lo = (q1 << 16) | q0;
+    buf[--i] = '0' + r;
+  } while(hi || lo);
+  printf(1, "%s", buf + i);
+}
+
+static void
+print(struct schedev *e)
+{
+  printu64(e->ns);
+  printf(1, " cpu %d pid %d ", e->cpu, e->pid);
+  switch(e->type){
+  case TR_FORK:
+    printf(1, "fork parent %d\n", e->arg);
+    break;
+  case TR_RUN:
+    printf(1, "run from cpu %d\n", e->arg);
+    break;
+  case TR_SWITCH:
+    if(e->arg >= 0 && e->arg < NELEM(states))
+      printf(1, "switch %s\n", states[e->arg]);
+    else
+      printf(1, "switch %d\n", e->arg);
+    break;
+  case TR_WAKEUP:
+    printf(1, "wakeup by %d\n", e->arg);
+    break;
+  case TR_EXIT:
+    printf(1, "exit parent %d\n", e->arg);
+    break;
+  case TR_TICKETS:
+    printf(1, "tickets %d\n", e->arg);
+    break;
+  default:
+    printf(1, "type %d arg %d\n", e->type, e->arg);
+  }
+}
+
+// Drain the trace and print it in time order.
+static void
+dump(int show)
+{
+  struct schedev t;
+  int i, j, n;
+
+  while((n = schedtrace(ev, NEV)) > 0){
+    for(i = 0; i < n; i++){
+      if(ev[i].cpu < NELEM(lastseq)){
+        if(show && lastseq[ev[i].cpu] && ev[i].seq != lastseq[ev[i].cpu] + 1)
+          printf(1, "cpu %d: lost %d events\n", ev[i].cpu,
+                 ev[i].seq - lastseq[ev[i].cpu] - 1);
+        lastseq[ev[i].cpu] = ev[i].seq;
+      }
+    }
+    if(!show)
+      continue;
+    // Each CPU's events are already in order; merge them.
+    for(i = 1; i < n; i++){
+      t = ev[i];
+      for(j = i; j > 0 && ev[j-1].ns > t.ns; j--)
+        ev[j] = ev[j-1];
+      ev[j] = t;
+    }
+    for(i = 0; i < n; i++)
+      print(&ev[i]);
+  }
+  if(n < 0)
+    printf(2, "schedtrace: failed\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int pid;
+
+  if(argc < 2){
+    dump(1);
+    exit();
+  }
+
+  dump(0);
+  pid = fork();
+  if(pid < 0){
+    printf(2, "schedtrace: fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    exec(argv[1], argv + 1);
+    printf(2, "schedtrace: exec %s failed\n", argv[1]);
+    exit();
+  }
+  while(wait() != pid)
+    ;
+  dump(1);
+  exit();
+}
@@ -2,6 +2,7 @@
 #include "stat.h"
 #include "user.h"
 #include "fcntl.h"
+#include "procstat.h"
 
 // Performance metrics structure
 struct PerfMetrics {
@@ -11,13 +12,43 @@ struct PerfMetrics {
     int waiting_time;
 };
 
-// Function to calculate metrics for a process
-void calculate_metrics(int pid, struct PerfMetrics *metrics) {
-    int creation = get_creation_time(pid);
-    int start = get_start_time(pid);
-    int completion = get_completion_time(pid);
-    int run_time = get_total_run_time(pid);
-    int ready_time = get_total_ready_time(pid);
+static struct procstat *stats;
+static int nstats;
+
+// Take a snapshot of every process and completion record,
+// growing the buffer until getprocstats() leaves room to spare.
+static int snapshot(void) {
+    int n;
+
+    for (;;) {
+        if (nstats > 0 && (n = getprocstats(stats, nstats)) < nstats)
+            return n;
+        if (stats)
+            free(stats);
+        nstats = nstats ? 2 * nstats : 128;
+        if ((stats = malloc(nstats * sizeof(*stats))) == 0) {
+            printf(2, "scheduler_perf_test: out of memory\n");
+            exit();
+        }
+    }
+}
+
+// Function to calculate metrics for a process from the n
+// entries of the last snapshot()
+void calculate_metrics(int pid, struct PerfMetrics *metrics, int n) {
+    int creation = -1, start = -1, completion = -1;
+    int run_time = -1, ready_time = -1;
+
+    for (int i = 0; i < n; i++) {
+        if (stats[i].pid == pid) {
+            creation = stats[i].creation_time;
+            start = stats[i].start_time;
+            completion = stats[i].completion_time;
+            run_time = stats[i].total_run_time;
+            ready_time = stats[i].total_ready_time;
+            break;
+        }
+    }
 
     // If completion time is 0, use current time
     if (completion == 0) {
@@ -77,7 +108,7 @@ void run_stressfs() {
     wait();
     
     // Calculate metrics for the completed child
-    calculate_metrics(pid, &metrics);
+    calculate_metrics(pid, &metrics, snapshot());
     printf(1, "stressfs metrics:\n");
     printf(1, "Turnaround time: %d\n", metrics.turnaround_time);
     printf(1, "Response time: %d\n", metrics.response_time);
@@ -107,7 +138,7 @@ void run_find() {
     wait();
     
     // Calculate metrics for the completed child
-    calculate_metrics(pid, &metrics);
+    calculate_metrics(pid, &metrics, snapshot());
     printf(1, "find metrics:\n");
     printf(1, "Turnaround time: %d\n", metrics.turnaround_time);
     printf(1, "Response time: %d\n", metrics.response_time);
@@ -155,7 +186,7 @@ void run_cat_uniq() {
     wait();
     
     // Calculate metrics for the completed child
-    calculate_metrics(pid, &metrics);
+    calculate_metrics(pid, &metrics, snapshot());
     printf(1, "cat|uniq metrics:\n");
     printf(1, "Turnaround time: %d\n", metrics.turnaround_time);
     printf(1, "Response time: %d\n", metrics.response_time);
@@ -191,7 +222,7 @@ void run_custom_workload() {
     wait();
     
     // Calculate metrics for the completed child
-    calculate_metrics(pid, &metrics);
+    calculate_metrics(pid, &metrics, snapshot());
     printf(1, "Custom workload metrics:\n");
     printf(1, "Turnaround time: %d\n", metrics.turnaround_time);
     printf(1, "Response time: %d\n", metrics.response_time);
@@ -290,11 +321,13 @@ void run_performance_test() {
     
     printf(1, "\nAll processes created, waiting for completion...\n");
     
-    // Wait for all processes to complete and collect metrics
-    for(int i = 0; i < 4; i++) {
+    // Wait for all processes to complete, then collect their
+    // metrics from one snapshot
+    for(int i = 0; i < 4; i++)
         wait();
-        calculate_metrics(pids[i], &metrics[i]);
-    }
+    int n = snapshot();
+    for(int i = 0; i < 4; i++)
+        calculate_metrics(pids[i], &metrics[i], n);
     
     // Print metrics for all processes
     printf(1, "\nstressfs metrics:\n");
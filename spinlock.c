@@ -6,15 +6,87 @@
 #include "x86.h"
 #include "memlayout.h"
 #include "mmu.h"
-#include "proc.h"
 #include "spinlock.h"
+#include "proc.h"
+#include "lockstat.h"
+
+// Every initialized lock, for sys_lockstat().  The list is
+// guarded by a bare xchg flag with interrupts off, since
+// initlock() runs before mycpu() and so acquire() work.
+static struct spinlock *locks[NLOCKSTAT];
+static uint lockslocked;
+
+static uint
+lockslist(void)
+{
+  uint eflags;
+
+  eflags = readeflags();
+  cli();
+  while(xchg(&lockslocked, 1) != 0)
+    ;
+  __sync_synchronize();
+  return eflags;
+}
+
+static void
+locksunlist(uint eflags)
+{
+  __sync_synchronize();
+  asm volatile("movl $0, %0" : "+m" (lockslocked) : );
+  if(eflags & FL_IF)
+    sti();
+}
 
+// Initialize lk without listing it.  For locks too many to
+// list one by one, like the per-process locks, whose owner
+// reports them added together instead (see proclocks()).
 void
-initlock(struct spinlock *lk, char *name)
+initlockunlisted(struct spinlock *lk, char *name)
 {
   lk->name = name;
-  lk->locked = 0;
+  lk->next = 0;
+  lk->owner = 0;
   lk->cpu = 0;
+  lk->nacquire = 0;
+  lk->ncontend = 0;
+  lk->spincycles = 0;
+}
+
+void
+initlock(struct spinlock *lk, char *name)
+{
+  struct spinlock **l, **free;
+  uint eflags;
+
+  initlockunlisted(lk, name);
+
+  // Locks past NLOCKSTAT still work but aren't reported.
+  free = 0;
+  eflags = lockslist();
+  for(l = locks; l < &locks[NLOCKSTAT]; l++){
+    if(*l == lk)
+      break;
+    if(*l == 0 && free == 0)
+      free = l;
+  }
+  if(l == &locks[NLOCKSTAT] && free)
+    *free = lk;
+  locksunlist(eflags);
+}
+
+// Forget lk before the memory holding it is freed.
+void
+freelock(struct spinlock *lk)
+{
+  struct spinlock **l;
+  uint eflags;
+
+  eflags = lockslist();
+  for(l = locks; l < &locks[NLOCKSTAT]; l++)
+    if(*l == lk)
+      *l = 0;
+  locksunlist(eflags);
 }
 
 // Acquire the lock.
@@ -24,13 +96,26 @@ initlock(struct spinlock *lk, char *name)
 void
 acquire(struct spinlock *lk)
 {
+  uint64 start;
+  uint ticket;
+
   pushcli(); // disable interrupts to avoid deadlock.
   if(holding(lk))
     panic("acquire");
 
-  // The xchg is atomic.
-  while(xchg(&lk->locked, 1) != 0)
-    ;
+  // Taking a ticket is one atomic add.  Waiters then only
+  // read owner, so its cache line is shared until release.
+  // Time the spin only if the lock was busy, so uncontended
+  // locks stay cheap.
+  ticket = __sync_fetch_and_add(&lk->next, 1);
+  if(lk->owner != ticket){
+    start = rdtsc();
+    while(lk->owner != ticket)
+      pause();
+    lk->ncontend++;
+    lk->spincycles += rdtsc() - start;
+  }
+  lk->nacquire++;
 
   // Tell the C compiler and the processor to not move loads or stores
   // past this point, to ensure that the critical section's memory
@@ -59,10 +144,9 @@ release(struct spinlock *lk)
   // stores; __sync_synchronize() tells them both not to.
   __sync_synchronize();
 
-  // Release the lock, equivalent to lk->locked = 0.
-  // This code can't use a C assignment, since it might
-  // not be atomic. A real OS would use C atomics here.
-  asm volatile("movl $0, %0" : "+m" (lk->locked) : );
+  // Admit the next ticket.  Only the holder writes owner,
+  // so a plain aligned store is atomic enough.
+  lk->owner = lk->owner + 1;
 
   popcli();
 }
@@ -91,7 +175,7 @@ holding(struct spinlock *lock)
 {
   int r;
   pushcli();
-  r = lock->locked && lock->cpu == mycpu();
+  r = lock->owner != lock->next && lock->cpu == mycpu();
   popcli();
   return r;
 }
@@ -124,3 +208,92 @@ popcli(void)
     sti();
 }
 
+// Copy the statistics of up to max locks to buf, the
+// per-process and sleepq locks summed into one entry each
+// at the end.
+// Returns the number copied or, if max is 0, the number
+// there are.
+int
+sys_lockstat(void)
+{
+  struct lockstat *buf, *s;
+  struct spinlock **l, sum[NLOCKSUM];
+  int max, n, nsum, i;
+  uint eflags;
+
+  if(argint(1, &max) < 0 || max < 0)
+    return -1;
+  if(argptr(0, (char**)&buf, max*sizeof(*buf)) < 0)
+    return -1;
+
+  nsum = proclocks(sum);
+
+  n = 0;
+  eflags = lockslist();
+  for(l = locks; l < &locks[NLOCKSTAT]; l++){
+    if(*l == 0)
+      continue;
+    if(max == 0){
+      n++;
+      continue;
+    }
+    if(n >= max)
+      break;
+    s = &buf[n++];
+    safestrcpy(s->name, (*l)->name, sizeof(s->name));
+    s->nacquire = (*l)->nacquire;
+    s->ncontend = (*l)->ncontend;
+    s->spinns = tsc2ns((*l)->spincycles);
+  }
+  locksunlist(eflags);
+  if(max == 0)
+    return n + nsum;
+  for(i = 0; i < nsum && n < max; i++){
+    s = &buf[n++];
+    safestrcpy(s->name, sum[i].name, sizeof(s->name));
+    s->nacquire = sum[i].nacquire;
+    s->ncontend = sum[i].ncontend;
+    s->spinns = tsc2ns(sum[i].spincycles);
+  }
+  return n;
+}
+
+// Microbenchmark: take a lock iters times around a tiny
+// critical section and store the time it took at *ns.
+// kind 0 uses a ticket lock through acquire()/release();
+// kind 1 the plain xchg test-and-set loop they replaced.
+static struct spinlock benchlock = { .name = "bench" };
+static uint benchtas;
+static volatile uint benchcount;
+
+int
+sys_lockbench(void)
+{
+  int kind, iters, i;
+  uint64 *ns, start;
+
+  if(argint(0, &kind) < 0 || argint(1, &iters) < 0 ||
+     argptr(2, (char**)&ns, sizeof(*ns)) < 0)
+    return -1;
+  if(kind != 0 && kind != 1)
+    return -1;
+
+  start = rdtsc();
+  for(i = 0; i < iters; i++){
+    if(kind == 0){
+      acquire(&benchlock);
+      benchcount++;
+      release(&benchlock);
+    } else {
+      pushcli();
+      while(xchg(&benchtas, 1) != 0)
+        ;
+      benchcount++;
+      __sync_synchronize();
+      asm volatile("movl $0, %0" : "+m" (benchtas) : );
+      popcli();
+    }
+  }
+  *ns = tsc2ns(rdtsc() - start);
+  return 0;
+}
@@ -1,11 +1,19 @@
-// Mutual exclusion lock.
+// Mutual exclusion lock.  A ticket lock: each acquirer takes
+// the next ticket and waits until owner reaches it, so CPUs get
+// the lock in the order they asked for it.
 struct spinlock {
-  uint locked;       // Is the lock held?
+  uint next;           // Next ticket to hand out
+  volatile uint owner; // Ticket allowed in; held if owner != next
 
   // For debugging:
   char *name;        // Name of lock.
   struct cpu *cpu;   // The cpu holding the lock.
   uint pcs[10];      // The call stack (an array of program counters)
                      // that locked the lock.
+
+  // Contention statistics, updated while the lock is held:
+  uint nacquire;     // Acquisitions
+  uint ncontend;     // Acquisitions that had to spin
+  uint64 spincycles; // TSC cycles spent spinning
 };
 
@@ -3,6 +3,7 @@
 #include "param.h"
 #include "memlayout.h"
 #include "mmu.h"
+#include "spinlock.h"
 #include "proc.h"
 #include "x86.h"
 #include "syscall.h"
@@ -13,7 +14,8 @@
 // library system call function. The saved user %esp points
 // to a saved program counter, and then the first argument.
 
-// Fetch the int at addr from the current process.
+// Fetch the int at addr from the current process.  User memory
+// is faulted in first, so that reading it can't trap.
 int
 fetchint(uint addr, int *ip)
 {
@@ -21,6 +23,8 @@ fetchint(uint addr, int *ip)
 
   if(addr >= curproc->sz || addr+4 > curproc->sz)
     return -1;
+  if(uvmtouch(curproc->pgdir, curproc->sz, addr, 4, 0) < 0)
+    return -1;
   *ip = *(int*)(addr);
   return 0;
 }
@@ -39,6 +43,10 @@ fetchstr(uint addr, char **pp)
   *pp = (char*)addr;
   ep = (char*)curproc->sz;
   for(s = *pp; s < ep; s++){
+    // Fault in each page before reading from it.
+    if((s == *pp || (uint)s % PGSIZE == 0) &&
+       uvmtouch(curproc->pgdir, curproc->sz, (uint)s, 1, 0) < 0)
+      return -1;
     if(*s == 0)
       return s - *pp;
   }
@@ -54,7 +62,7 @@ argint(int n, int *ip)
 
 // Fetch the nth word-sized system call argument as a pointer
 // to a block of memory of size bytes.  Check that the pointer
-// lies within the process address space.
+// lies within the process address space, and fault the block in.
 int
 argptr(int n, char **pp, int size)
 {
@@ -65,6 +73,9 @@ argptr(int n, char **pp, int size)
     return -1;
   if(size < 0 || (uint)i >= curproc->sz || (uint)i+size > curproc->sz)
     return -1;
+  // Several system calls fill the buffer with locks held.
+  if(uvmtouch(curproc->pgdir, curproc->sz, i, size, 1) < 0)
+    return -1;
   *pp = (char*)i;
   return 0;
 }
@@ -112,6 +123,27 @@ extern int sys_get_start_time(void);
 extern int sys_get_completion_time(void);
 extern int sys_get_total_run_time(void);
 extern int sys_get_total_ready_time(void);
+extern int sys_set_priority(void);
+extern int sys_get_priority(void);
+extern int sys_sleep_until(void);
+extern int sys_getprocstats(void);
+extern int sys_drainperf(void);
+extern int sys_get_creation_time_ns(void);
+extern int sys_get_start_time_ns(void);
+extern int sys_get_completion_time_ns(void);
+extern int sys_get_total_run_time_ns(void);
+extern int sys_get_total_ready_time_ns(void);
+extern int sys_getswtchcost(void);
+extern int sys_schedtrace(void);
+extern int sys_profctl(void);
+extern int sys_getprof(void);
+extern int sys_lockstat(void);
+extern int sys_lockbench(void);
+extern int sys_setaffinity(void);
+extern int sys_getaffinity(void);
+extern int sys_cpustat(void);
+extern int sys_setquantum(void);
+extern int sys_getquantum(void);
 
 
 
@@ -146,6 +178,27 @@ static int (*syscalls[])(void) = {
 [SYS_get_completion_time] sys_get_completion_time,
 [SYS_get_total_run_time]  sys_get_total_run_time,
 [SYS_get_total_ready_time] sys_get_total_ready_time,
+[SYS_set_priority] sys_set_priority,
+[SYS_get_priority] sys_get_priority,
+[SYS_sleep_until]  sys_sleep_until,
+[SYS_getprocstats] sys_getprocstats,
+[SYS_drainperf]    sys_drainperf,
+[SYS_get_creation_time_ns] sys_get_creation_time_ns,
+[SYS_get_start_time_ns] sys_get_start_time_ns,
+[SYS_get_completion_time_ns] sys_get_completion_time_ns,
+[SYS_get_total_run_time_ns] sys_get_total_run_time_ns,
+[SYS_get_total_ready_time_ns] sys_get_total_ready_time_ns,
+[SYS_getswtchcost] sys_getswtchcost,
+[SYS_schedtrace]   sys_schedtrace,
+[SYS_profctl]      sys_profctl,
+[SYS_getprof]      sys_getprof,
+[SYS_lockstat]     sys_lockstat,
+[SYS_lockbench]    sys_lockbench,
+[SYS_setaffinity]  sys_setaffinity,
+[SYS_getaffinity]  sys_getaffinity,
+[SYS_cpustat]      sys_cpustat,
+[SYS_setquantum]   sys_setquantum,
+[SYS_getquantum]   sys_getquantum,
 };
 
 void
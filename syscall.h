@@ -29,4 +29,24 @@
 #define SYS_get_completion_time 28
 #define SYS_get_total_run_time  29
 #define SYS_get_total_ready_time 30
-
+#define SYS_set_priority 31
+#define SYS_get_priority 32
+#define SYS_sleep_until  33
+#define SYS_getprocstats 34
+#define SYS_drainperf    35
+#define SYS_get_creation_time_ns 36
+#define SYS_get_start_time_ns 37
+#define SYS_get_completion_time_ns 38
+#define SYS_get_total_run_time_ns 39
+#define SYS_get_total_ready_time_ns 40
+#define SYS_getswtchcost 41
+#define SYS_schedtrace   42
+#define SYS_profctl      43
+#define SYS_getprof      44
+#define SYS_lockstat     45
+#define SYS_lockbench    46
+#define SYS_setaffinity  47
+#define SYS_getaffinity  48
+#define SYS_cpustat      49
+#define SYS_setquantum   50
+#define SYS_getquantum   51
@@ -5,7 +5,9 @@
 #include "param.h"
 #include "memlayout.h"
 #include "mmu.h"
+#include "spinlock.h"
 #include "proc.h"
+#include "procstat.h"
 
 int
 sys_fork(void)
@@ -60,21 +62,22 @@ int
 sys_sleep(void)
 {
   int n;
-  uint ticks0;
 
   if(argint(0, &n) < 0)
     return -1;
-  acquire(&tickslock);
-  ticks0 = ticks;
-  while(ticks - ticks0 < n){
-    if(myproc()->killed){
-      release(&tickslock);
-      return -1;
-    }
-    sleep(&ticks, &tickslock);
-  }
-  release(&tickslock);
-  return 0;
+  return sleepuntil(ticks + n);
+}
+
+// Sleep until the given absolute tick, as returned by uptime().
+// Periodic loops use this to avoid accumulating drift.
+int
+sys_sleep_until(void)
+{
+  int tick;
+
+  if(argint(0, &tick) < 0)
+    return -1;
+  return sleepuntil(tick);
 }
 
 // return how many clock tick interrupts have occurred
@@ -141,3 +144,83 @@ sys_get_total_ready_time(void)
     return -1;
   return get_total_ready_time(pid);
 }
+
+// Like get_creation_time, but in nanoseconds stored at *ns.
+int
+sys_get_creation_time_ns(void)
+{
+  int pid;
+  uint64 *ns;
+  struct perfrec r;
+
+  if(argint(0, &pid) < 0 || argptr(1, (char**)&ns, sizeof(*ns)) < 0)
+    return -1;
+  if(getprocns(pid, &r) < 0)
+    return -1;
+  *ns = r.creation_ns;
+  return 0;
+}
+
+// Like get_start_time, but in nanoseconds stored at *ns.
+int
+sys_get_start_time_ns(void)
+{
+  int pid;
+  uint64 *ns;
+  struct perfrec r;
+
+  if(argint(0, &pid) < 0 || argptr(1, (char**)&ns, sizeof(*ns)) < 0)
+    return -1;
+  if(getprocns(pid, &r) < 0)
+    return -1;
+  *ns = r.start_ns;
+  return 0;
+}
+
+// Like get_completion_time, but in nanoseconds stored at *ns.
+int
+sys_get_completion_time_ns(void)
+{
+  int pid;
+  uint64 *ns;
+  struct perfrec r;
+
+  if(argint(0, &pid) < 0 || argptr(1, (char**)&ns, sizeof(*ns)) < 0)
+    return -1;
+  if(getprocns(pid, &r) < 0)
+    return -1;
+  *ns = r.completion_ns;
+  return 0;
+}
+
+// Like get_total_run_time, but in nanoseconds stored at *ns.
+int
+sys_get_total_run_time_ns(void)
+{
+  int pid;
+  uint64 *ns;
+  struct perfrec r;
+
+  if(argint(0, &pid) < 0 || argptr(1, (char**)&ns, sizeof(*ns)) < 0)
+    return -1;
+  if(getprocns(pid, &r) < 0)
+    return -1;
+  *ns = r.run_ns;
+  return 0;
+}
+
+// Like get_total_ready_time, but in nanoseconds stored at *ns.
+int
+sys_get_total_ready_time_ns(void)
+{
+  int pid;
+  uint64 *ns;
+  struct perfrec r;
+
+  if(argint(0, &pid) < 0 || argptr(1, (char**)&ns, sizeof(*ns)) < 0)
+    return -1;
+  if(getprocns(pid, &r) < 0)
+    return -1;
+  *ns = r.ready_ns;
+  return 0;
+}
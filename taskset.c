@@ -0,0 +1,121 @@
+// Run a command on a set of CPUs, or show or change the CPUs
+// of a running process.  Masks are hex, bit i for CPU i.
+//
+//   taskset mask cmd args   run cmd, and everything it forks,
+//                           on the CPUs in mask
+//   taskset -p pid          print pid's mask
+//   taskset -p pid mask     change it
+//
+// After a run, the migrations of processes started during it
+// are totalled from getprocstats().
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "procstat.h"
+
+static struct procstat *stats;
+static int nstats;
+
+// Read every process and completion record into stats,
+// growing it until getprocstats() leaves room to spare.
+// Returns the number of entries.
+static int
+snapshot(void)
+{
+  int n;
+
+  for(;;){
+    if(nstats > 0 && (n = getprocstats(stats, nstats)) < nstats)
+      return n;
+    if(stats)
+      free(stats);
+    nstats = nstats ? 2*nstats : 128;
+    if((stats = malloc(nstats * sizeof(*stats))) == 0){
+      printf(2, "taskset: out of memory\n");
+      exit();
+    }
+  }
+}
+
+static int
+hexmask(char *s)
+{
+  uint m;
+
+  if(s[0] == '0' && s[1] == 'x')
+    s += 2;
+  if(*s == 0)
+    return -1;
+  for(m = 0; *s; s++){
+    if(*s >= '0' && *s <= '9')
+      m = m*16 + *s - '0';
+    else if(*s >= 'a' && *s <= 'f')
+      m = m*16 + *s - 'a' + 10;
+    else
+      return -1;
+  }
+  return m;
+}
+
+static void
+usage(void)
+{
+  printf(2, "usage: taskset mask cmd [args]\n"
+            "       taskset -p pid [mask]\n");
+  exit();
+}
+
+int
+main(int argc, char *argv[])
+{
+  int pid, mask, n, i, nmig, nproc;
+
+  if(argc >= 3 && strcmp(argv[1], "-p") == 0){
+    pid = atoi(argv[2]);
+    if(argc == 3){
+      if((mask = getaffinity(pid)) < 0){
+        printf(2, "taskset: no process %d\n", pid);
+        exit();
+      }
+      printf(1, "pid %d mask %x\n", pid, mask);
+      exit();
+    }
+    if((mask = hexmask(argv[3])) < 0)
+      usage();
+    if(setaffinity(pid, mask) < 0)
+      printf(2, "taskset: cannot set pid %d to %x\n", pid, mask);
+    exit();
+  }
+  if(argc < 3 || (mask = hexmask(argv[1])) < 0)
+    usage();
+
+  pid = fork();
+  if(pid < 0){
+    printf(2, "taskset: fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    if(setaffinity(getpid(), mask) < 0){
+      printf(2, "taskset: bad mask %x\n", mask);
+      exit();
+    }
+    exec(argv[2], argv + 2);
+    printf(2, "taskset: exec %s failed\n", argv[2]);
+    exit();
+  }
+  while(wait() != pid)
+    ;
+
+  // Pids only grow, so the run's processes are those from pid on.
+  n = snapshot();
+  nmig = nproc = 0;
+  for(i = 0; i < n; i++){
+    if(stats[i].pid < pid)
+      continue;
+    nproc++;
+    nmig += stats[i].nmigrate;
+  }
+  printf(1, "taskset: %d processes, %d migrations\n", nproc, nmig);
+  exit();
+}
@@ -0,0 +1,106 @@
+// Scheduler event trace.
+//
+// Each CPU logs events into its own ring of the last NTRACE
+// events.  All trace() callers hold a spinlock, so interrupts
+// are off and a ring has exactly one writer, which never takes
+// a lock.  Events are stamped with the raw TSC and converted to
+// ns only when schedtrace() copies them out.
+//
+// A reader copies events and then rereads the ring's head;
+// any event the writer may have overwritten meanwhile is
+// dropped, so readers never block tracing.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "x86.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "trace.h"
+
+struct tracering {
+  struct schedev ev[NTRACE];
+  volatile uint head;   // events ever logged
+  uint tail;            // events ever drained
+};
+
+static struct tracering tracering[NCPU];
+static struct spinlock tracelock;  // serializes readers only
+
+void
+traceinit(void)
+{
+  initlock(&tracelock, "trace");
+}
+
+// Log an event on this CPU's ring.  Interrupts must be off.
+void
+trace(int type, int pid, int arg)
+{
+  struct tracering *r;
+  struct schedev *e;
+  uint h;
+
+  r = &tracering[cpuid()];
+  h = r->head;
+  e = &r->ev[h % NTRACE];
+  e->ns = rdtsc();
+  e->seq = h + 1;
+  e->pid = pid;
+  e->arg = arg;
+  e->cpu = r - tracering;
+  e->type = type;
+  __sync_synchronize();
+  r->head = h + 1;
+}
+
+// Copy up to max events not yet drained into buf, CPU by CPU.
+int
+tracedrain(struct schedev *buf, int max)
+{
+  struct tracering *r;
+  uint h, i, start;
+  int j, n, n0;
+
+  n = 0;
+  acquire(&tracelock);
+  for(r = tracering; r < &tracering[ncpu] && n < max; r++){
+    h = r->head;
+    if(h - r->tail >= NTRACE)
+      r->tail = h - NTRACE + 1;
+    start = r->tail;
+    n0 = n;
+    for(i = start; i != h && n < max; i++)
+      buf[n++] = r->ev[i % NTRACE];
+    __sync_synchronize();
+    h = r->head;
+    // Drop events the writer may have overwritten meanwhile.
+    j = n0;
+    for(i = start; j < n; j++, i++){
+      if(h - i >= NTRACE)
+        continue;
+      buf[n0] = buf[j];
+      buf[n0].ns = tscsince(buf[n0].ns);
+      n0++;
+    }
+    r->tail = i;
+    n = n0;
+  }
+  release(&tracelock);
+  return n;
+}
+
+int
+sys_schedtrace(void)
+{
+  struct schedev *buf;
+  int max;
+
+  if(argint(1, &max) < 0 || max < 0)
+    return -1;
+  if(argptr(0, (char**)&buf, max*sizeof(*buf)) < 0)
+    return -1;
+  return tracedrain(buf, max);
+}
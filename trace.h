@@ -0,0 +1,17 @@
+// Scheduler trace events, as returned by schedtrace().
+
+#define TR_FORK     1   // pid allocated; arg = parent pid
+#define TR_RUN      2   // pid dispatched; arg = CPU it last ran on
+#define TR_SWITCH   3   // pid left the CPU; arg = its new state
+#define TR_WAKEUP   4   // pid woken; arg = waker pid, 0 if none
+#define TR_EXIT     5   // pid exited; arg = parent pid
+#define TR_TICKETS  6   // pid's tickets changed; arg = new count
+
+struct schedev {
+  uint64 ns;    // since boot
+  uint seq;     // per-CPU event number from 1; gaps mean lost events
+  int pid;
+  int arg;
+  ushort cpu;
+  ushort type;
+};
@@ -3,10 +3,10 @@
 #include "param.h"
 #include "memlayout.h"
 #include "mmu.h"
+#include "spinlock.h"
 #include "proc.h"
 #include "x86.h"
 #include "traps.h"
-#include "spinlock.h"
 
 // Interrupt descriptor table (shared by all CPUs).
 struct gatedesc idt[256];
@@ -51,17 +51,25 @@ trap(struct trapframe *tf)
 
   switch(tf->trapno){
   case T_IRQ0 + IRQ_TIMER:
+    if(profiling)
+      profsample(tf);
     if(cpuid() == 0){
       acquire(&tickslock);
       ticks++;
-      wakeup(&ticks);
       release(&tickslock);
+      timerwake(ticks);
+      rqclock();
     }
+    rqbalance();
     if(myproc() && myproc()->state == RUNNING) {
       myproc()->runticks++;
     }
     lapiceoi();
     break;
+  case T_IRQ0 + IRQ_WAKE:
+    // Sent by rqadd(); scheduler() will find the new work.
+    lapiceoi();
+    break;
   case T_IRQ0 + IRQ_IDE:
     ideintr();
     lapiceoi();
@@ -84,6 +92,15 @@ trap(struct trapframe *tf)
     lapiceoi();
     break;
 
+  case T_PGFLT:
+    // A heap page not yet allocated or a write to a page shared
+    // by fork().  The kernel faults in user memory it uses with
+    // uvmtouch() beforehand, so these come from user code.
+    if(myproc() &&
+       uvmfault(myproc()->pgdir, myproc()->sz, rcr2(), tf->err & FEC_WR) == 0)
+      break;
+    // Otherwise a bad access; fall through.
+
   //PAGEBREAK: 13
   default:
     if(myproc() == 0 || (tf->cs&3) == 0){
@@ -106,10 +123,11 @@ trap(struct trapframe *tf)
   if(myproc() && myproc()->killed && (tf->cs&3) == DPL_USER)
     exit();
 
-  // Force process to give up CPU on clock tick.
+  // Force process to give up CPU on clock tick
+  // once it has used up its time slice (see rqtick).
   // If interrupts were on while locks held, would need to check nlock.
   if(myproc() && myproc()->state == RUNNING &&
-     tf->trapno == T_IRQ0+IRQ_TIMER)
+     tf->trapno == T_IRQ0+IRQ_TIMER && rqtick(myproc()))
     yield();
 
   // Check if the process has been killed since we yielded
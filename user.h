@@ -1,5 +1,11 @@
 struct stat;
 struct rtcdate;
+struct procstat;
+struct perfrec;
+struct schedev;
+struct profent;
+struct lockstat;
+struct cpustat;
 
 // system calls
 int fork(void);
@@ -31,6 +37,27 @@ int get_start_time(int pid);
 int get_completion_time(int pid);
 int get_total_run_time(int pid);
 int get_total_ready_time(int pid);
+int set_priority(int priority);
+int get_priority(int pid);
+int sleep_until(int tick);
+int getprocstats(struct procstat*, int max);
+int drainperf(struct perfrec*, int max);
+int get_creation_time_ns(int pid, uint64 *ns);
+int get_start_time_ns(int pid, uint64 *ns);
+int get_completion_time_ns(int pid, uint64 *ns);
+int get_total_run_time_ns(int pid, uint64 *ns);
+int get_total_ready_time_ns(int pid, uint64 *ns);
+int getswtchcost(uint64 *ns);
+int schedtrace(struct schedev*, int max);
+int profctl(int on);
+int getprof(struct profent*, int max);
+int lockstat(struct lockstat*, int max);
+int lockbench(int kind, int iters, uint64 *ns);
+int setaffinity(int pid, uint mask);
+int getaffinity(int pid);
+int cpustat(struct cpustat*, int max);
+int setquantum(int pid, int ticks);
+int getquantum(int pid);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -49,6 +76,12 @@ int atoi(const char*);
 
 struct stat;
 struct rtcdate;
+struct procstat;
+struct perfrec;
+struct schedev;
+struct profent;
+struct lockstat;
+struct cpustat;
 
 // system calls
 int fork(void);
@@ -80,6 +113,27 @@ int get_start_time(int pid);
 int get_completion_time(int pid);
 int get_total_run_time(int pid);
 int get_total_ready_time(int pid);
+int set_priority(int priority);
+int get_priority(int pid);
+int sleep_until(int tick);
+int getprocstats(struct procstat*, int max);
+int drainperf(struct perfrec*, int max);
+int get_creation_time_ns(int pid, uint64 *ns);
+int get_start_time_ns(int pid, uint64 *ns);
+int get_completion_time_ns(int pid, uint64 *ns);
+int get_total_run_time_ns(int pid, uint64 *ns);
+int get_total_ready_time_ns(int pid, uint64 *ns);
+int getswtchcost(uint64 *ns);
+int schedtrace(struct schedev*, int max);
+int profctl(int on);
+int getprof(struct profent*, int max);
+int lockstat(struct lockstat*, int max);
+int lockbench(int kind, int iters, uint64 *ns);
+int setaffinity(int pid, uint mask);
+int getaffinity(int pid);
+int cpustat(struct cpustat*, int max);
+int setquantum(int pid, int ticks);
+int getquantum(int pid);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -4,6 +4,7 @@
 #include "x86.h"
 #include "memlayout.h"
 #include "mmu.h"
+#include "spinlock.h"
 #include "proc.h"
 #include "elf.h"
 
@@ -319,39 +320,110 @@ clearpteu(pde_t *pgdir, char *uva)
 }
 
 // Given a parent process's page table, create a copy
-// of it for a child.
+// of it for a child.  The pages themselves are shared:
+// writable ones become read-only and PTE_COW in both
+// tables, and the first write to one takes a private
+// copy in uvmfault().  Heap pages never touched stay
+// holes in both.
 pde_t*
 copyuvm(pde_t *pgdir, uint sz)
 {
   pde_t *d;
   pte_t *pte;
   uint pa, i, flags;
-  char *mem;
 
   if((d = setupkvm()) == 0)
     return 0;
   for(i = 0; i < sz; i += PGSIZE){
-    if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0)
-      panic("copyuvm: pte should exist");
+    if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0){
+      i = PGADDR(PDX(i) + 1, 0, 0) - PGSIZE;
+      continue;
+    }
     if(!(*pte & PTE_P))
-      panic("copyuvm: page not present");
+      continue;
+    if(*pte & PTE_W)
+      *pte = (*pte & ~PTE_W) | PTE_COW;
     pa = PTE_ADDR(*pte);
     flags = PTE_FLAGS(*pte);
-    if((mem = kalloc()) == 0)
-      goto bad;
-    memmove(mem, (char*)P2V(pa), PGSIZE);
-    if(mappages(d, (void*)i, PGSIZE, V2P(mem), flags) < 0) {
-      kfree(mem);
+    if(mappages(d, (void*)i, PGSIZE, pa, flags) < 0)
       goto bad;
-    }
+    kref(P2V(pa));
   }
+  // Drop the parent's now stale writable mappings.
+  lcr3(rcr3());
   return d;
 
 bad:
+  lcr3(rcr3());
   freevm(d);
   return 0;
 }
 
+// Resolve a fault on user address va in an address space of
+// sz bytes.  A page sbrk() reserved but never touched gets a
+// zeroed page; a write to a copy-on-write page gets a private
+// copy, or the page itself if no one else still maps it.
+// Returns -1 if neither applies, so the access is bad, or if
+// memory is short.
+int
+uvmfault(pde_t *pgdir, uint sz, uint va, int write)
+{
+  pte_t *pte;
+  uint pa, flags;
+  char *mem;
+
+  if(va >= sz || va >= KERNBASE)
+    return -1;
+  va = PGROUNDDOWN(va);
+  pte = walkpgdir(pgdir, (void*)va, 0);
+  if(pte == 0 || (*pte & PTE_P) == 0){
+    if((mem = kalloc()) == 0)
+      return -1;
+    memset(mem, 0, PGSIZE);
+    if(mappages(pgdir, (char*)va, PGSIZE, V2P(mem), PTE_W|PTE_U) < 0){
+      kfree(mem);
+      return -1;
+    }
+    return 0;
+  }
+  if(!write || (*pte & PTE_COW) == 0)
+    return -1;
+  pa = PTE_ADDR(*pte);
+  flags = (PTE_FLAGS(*pte) | PTE_W) & ~PTE_COW;
+  if(krefs(P2V(pa)) == 1)
+    *pte = pa | flags;
+  else {
+    if((mem = kalloc()) == 0)
+      return -1;
+    memmove(mem, P2V(pa), PGSIZE);
+    *pte = V2P(mem) | flags;
+    kfree(P2V(pa));
+  }
+  invlpg((void*)va);
+  return 0;
+}
+
+// Make [va, va+n) of an address space of sz bytes present,
+// and if write is set writable by the kernel, so that a system
+// call can read or fill a user buffer, perhaps while holding
+// locks, without taking page faults.  Returns -1 if va is
+// outside sz or that needs memory there isn't.
+int
+uvmtouch(pde_t *pgdir, uint sz, uint va, uint n, int write)
+{
+  pte_t *pte;
+  uint a;
+
+  for(a = PGROUNDDOWN(va); a < va + n; a += PGSIZE){
+    pte = walkpgdir(pgdir, (char*)a, 0);
+    if(pte && (*pte & PTE_P) && (!write || (*pte & PTE_COW) == 0))
+      continue;
+    if(uvmfault(pgdir, sz, a, write) < 0)
+      return -1;
+  }
+  return 0;
+}
+
 //PAGEBREAK!
 // Map user virtual address to kernel address.
 char*
@@ -367,11 +439,12 @@ uva2ka(pde_t *pgdir, char *uva)
   return (char*)P2V(PTE_ADDR(*pte));
 }
 
-// Copy len bytes from p to user address va in page table pgdir.
+// Copy len bytes from p to user address va in page table pgdir,
+// of an address space sz bytes long.
 // Most useful when pgdir is not the current page table.
 // uva2ka ensures this only works for PTE_U pages.
 int
-copyout(pde_t *pgdir, uint va, void *p, uint len)
+copyout(pde_t *pgdir, uint sz, uint va, void *p, uint len)
 {
   char *buf, *pa0;
   uint n, va0;
@@ -379,6 +452,10 @@ copyout(pde_t *pgdir, uint va, void *p, uint len)
   buf = (char*)p;
   while(len > 0){
     va0 = (uint)PGROUNDDOWN(va);
+    // Writes through the kernel mapping don't fault, so fill
+    // holes and break copy-on-write sharing here.
+    if(uvmtouch(pgdir, sz, va, 1, 1) < 0)
+      return -1;
     pa0 = uva2ka(pgdir, (char*)va0);
     if(pa0 == 0)
       return -1;